@@ -15,14 +15,32 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# The lowest log level compiled in: debug, info or warning.
+# The messages below it cost nothing at runtime, e.g. "qmake PM3GUI_LOG_LEVEL=warning"
+isEmpty(PM3GUI_LOG_LEVEL) {
+    CONFIG(debug, debug|release): PM3GUI_LOG_LEVEL = debug
+    else: PM3GUI_LOG_LEVEL = info
+}
+equals(PM3GUI_LOG_LEVEL, info): DEFINES += QT_NO_DEBUG_OUTPUT
+equals(PM3GUI_LOG_LEVEL, warning): DEFINES += QT_NO_DEBUG_OUTPUT QT_NO_INFO_OUTPUT
+
 SOURCES += \
+    common/devicepool.cpp \
+    common/hexcodec.cpp \
+    common/keystore.cpp \
+    common/log.cpp \
     common/myeventfilter.cpp \
+    common/patternset.cpp \
     main.cpp \
     common/pm3process.cpp \
+    common/solverpool.cpp \
     common/util.cpp \
+    module/cardimage.cpp \
     module/lf.cpp \
     module/mifare.cpp \
+    module/provisioner.cpp \
     module/t55xxtab.cpp \
+    ui/mf_provisiondialog.cpp \
     ui/mf_trailerdecoderdialog.cpp \
     ui/mf_sim_simdialog.cpp \
     ui/mf_uid_parameterdialog.cpp \
@@ -30,12 +48,21 @@ SOURCES += \
     ui/mf_attack_hardnesteddialog.cpp \
 
 HEADERS += \
+    common/devicepool.h \
+    common/hexcodec.h \
+    common/keystore.h \
+    common/log.h \
     common/myeventfilter.h \
+    common/patternset.h \
     common/pm3process.h \
+    common/solverpool.h \
     common/util.h \
+    module/cardimage.h \
     module/lf.h \
     module/mifare.h \
+    module/provisioner.h \
     module/t55xxtab.h \
+    ui/mf_provisiondialog.h \
     ui/mf_trailerdecoderdialog.h \
     ui/mf_sim_simdialog.h \
     ui/mf_uid_parameterdialog.h \
@@ -44,6 +71,7 @@ HEADERS += \
 
 FORMS += \
     ui/t55xxtab.ui \
+    ui/mf_provisiondialog.ui \
     ui/mf_trailerdecoderdialog.ui \
     ui/mf_sim_simdialog.ui \
     ui/mf_uid_parameterdialog.ui \
@@ -0,0 +1,217 @@
+﻿#include "devicepool.h"
+
+DevicePool::DevicePool(QObject *parent) : QObject(parent)
+{
+    nextJobId = 0;
+    qRegisterMetaType<DevicePool::DeviceState>("DevicePool::DeviceState");
+}
+
+DevicePool::~DevicePool()
+{
+    removeAll();
+}
+
+int DevicePool::addDevice(const QString& path, const QStringList& args, const QString& port)
+{
+    int id = devices.size();
+    Device* dev = new Device;
+    dev->thread = new QThread(this);
+    dev->pm3 = new PM3Process(dev->thread);
+    dev->idleTimer = new QTimer(this);
+    dev->idleTimer->setSingleShot(true);
+    dev->port = port;
+    dev->state = DEVICE_OFFLINE;
+    dev->scannedLength = 0;
+    dev->isResultFound = false;
+    devices.append(dev);
+
+    connect(dev->thread, &QThread::finished, dev->pm3, &PM3Process::deleteLater);
+    connect(dev->pm3, &PM3Process::newOutput, this, [ = ](const QString & output)
+    {
+        onOutput(id, output);
+    });
+    connect(dev->pm3, &PM3Process::PM3StatedChanged, this, [ = ](bool st, const QString & info)
+    {
+        onStateChanged(id, st, info);
+    });
+    connect(dev->pm3, &PM3Process::HWConnectFailed, this, [ = ]()
+    {
+        onStateChanged(id, false, tr("Failed to connect to the hardware"));
+    });
+    connect(dev->idleTimer, &QTimer::timeout, this, [ = ]()
+    {
+        finishJob(id);
+    });
+    // the thread is not started yet, so it's safe to set them directly
+    dev->pm3->setProcEnv(&procEnv);
+    dev->pm3->setWorkingDir(workingDir);
+    dev->thread->start();
+
+    // the PM3Process lives in its own thread now, so call its slots by queued invocation
+    QMetaObject::invokeMethod(dev->pm3, "connectPM3", Qt::QueuedConnection, Q_ARG(QString, path), Q_ARG(QStringList, args));
+    return id;
+}
+
+void DevicePool::removeAll()
+{
+    for(Device* dev : devices)
+    {
+        // the ids in the lambdas are invalid after this
+        disconnect(dev->pm3, nullptr, this, nullptr);
+        delete dev->idleTimer;
+        QMetaObject::invokeMethod(dev->pm3, "killPM3", Qt::BlockingQueuedConnection);
+        dev->thread->quit();
+        dev->thread->wait(5000);
+        dev->thread->deleteLater();
+        delete dev;
+    }
+    devices.clear();
+}
+
+int DevicePool::deviceCount() const
+{
+    return devices.size();
+}
+
+int DevicePool::onlineCount() const
+{
+    int result = 0;
+    for(const Device* dev : devices)
+    {
+        if(dev->state != DEVICE_OFFLINE)
+            result++;
+    }
+    return result;
+}
+
+QString DevicePool::getPort(int device) const
+{
+    return devices[device]->port;
+}
+
+DevicePool::DeviceState DevicePool::getState(int device) const
+{
+    return devices[device]->state;
+}
+
+int DevicePool::submit(const QString& cmd, const Util::ReturnTrigger& trigger)
+{
+    Job job = {nextJobId++, cmd, trigger, -1};
+    jobQueue.append(job);
+    dispatch();
+    return job.id;
+}
+
+int DevicePool::submitToEach(const QString& cmd, const Util::ReturnTrigger& trigger)
+{
+    // one job for every online device, a busy one runs it after its current job.
+    // Returns the number of the jobs.
+    int count = 0;
+    for(int i = 0; i < devices.size(); i++)
+    {
+        if(devices[i]->state == DEVICE_OFFLINE)
+            continue;
+        Job job = {nextJobId++, cmd, trigger, i};
+        jobQueue.append(job);
+        count++;
+    }
+    dispatch();
+    return count;
+}
+
+void DevicePool::clearJobs()
+{
+    jobQueue.clear();
+}
+
+void DevicePool::setProcEnv(const QStringList& env)
+{
+    procEnv = env;
+}
+
+void DevicePool::setWorkingDir(const QString& dir)
+{
+    workingDir = dir;
+}
+
+void DevicePool::dispatch()
+{
+    for(int i = 0; i < devices.size() && !jobQueue.isEmpty(); i++)
+    {
+        Device* dev = devices[i];
+        if(dev->state != DEVICE_IDLE)
+            continue;
+        int jobIndex = -1;
+        for(int j = 0; j < jobQueue.size() && jobIndex == -1; j++)
+        {
+            if(jobQueue[j].device == -1 || jobQueue[j].device == i)
+                jobIndex = j;
+        }
+        if(jobIndex == -1)
+            continue;
+        dev->currJob.clear();
+        dev->currJob.append(jobQueue.takeAt(jobIndex));
+        dev->output.clear();
+        dev->scannedLength = 0;
+        dev->isResultFound = false;
+        dev->state = DEVICE_BUSY;
+        emit deviceStateChanged(i, dev->state, dev->currJob.first().cmd);
+        emit jobStarted(dev->currJob.first().id, i, dev->currJob.first().cmd);
+        qCDebug(lcPool) << "pool" << dev->port << "executing:" << dev->currJob.first().cmd;
+        QMetaObject::invokeMethod(dev->pm3, "write", Qt::QueuedConnection, Q_ARG(QString, dev->currJob.first().cmd + "\n"));
+        dev->idleTimer->start(static_cast<int>(dev->currJob.first().trigger.waitTime));
+    }
+}
+
+void DevicePool::onOutput(int device, const QString& output)
+{
+    // the same completion rules as Util::execCMDWithOutput():
+    // finish when one of the expected outputs appears(plus a short settle time), or when the client is idle for waitTime
+    Device* dev = devices[device];
+    if(dev->state != DEVICE_BUSY)
+        return;
+    dev->output.append(output);
+    const Util::ReturnTrigger& trigger = dev->currJob.first().trigger;
+    if(!dev->isResultFound)
+    {
+        int from = qMax(0, dev->scannedLength - Util::triggerOverlap);
+        dev->scannedLength = dev->output.length();
+        dev->isResultFound = trigger.isMatched(dev->output.midRef(from));
+    }
+    dev->idleTimer->start(dev->isResultFound ? 200 : static_cast<int>(trigger.waitTime));
+}
+
+void DevicePool::onStateChanged(int device, bool st, const QString& info)
+{
+    Device* dev = devices[device];
+    // an offline device must not take the next job
+    if(!st && dev->state == DEVICE_BUSY)
+        finishJob(device, false);
+    // the jobs pinned to an offline device would wait forever
+    if(!st)
+    {
+        for(int i = jobQueue.size() - 1; i >= 0; i--)
+        {
+            if(jobQueue[i].device == device)
+                jobQueue.removeAt(i);
+        }
+    }
+    dev->state = st ? DEVICE_IDLE : DEVICE_OFFLINE;
+    emit deviceStateChanged(device, dev->state, info);
+    if(st)
+        dispatch();
+}
+
+void DevicePool::finishJob(int device, bool isDispatching)
+{
+    Device* dev = devices[device];
+    dev->idleTimer->stop();
+    if(dev->state != DEVICE_BUSY || dev->currJob.isEmpty())
+        return;
+    Job job = dev->currJob.takeFirst();
+    dev->state = DEVICE_IDLE;
+    emit jobFinished(job.id, device, job.cmd, dev->output, job.trigger.expectedOutputs.isEmpty() || dev->isResultFound);
+    emit deviceStateChanged(device, dev->state, "");
+    if(isDispatching)
+        dispatch();
+}
@@ -0,0 +1,86 @@
+﻿#ifndef DEVICEPOOL_H
+#define DEVICEPOOL_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QThread>
+#include <QTimer>
+#include <QDebug>
+
+#include "pm3process.h"
+#include "util.h"
+
+// Drives several PM3 devices at once, each one has its own client(PM3Process) on its own thread.
+// Jobs are queued and handed to the first idle device, or to the device they are pinned to.
+class DevicePool : public QObject
+{
+    Q_OBJECT
+public:
+    enum DeviceState
+    {
+        DEVICE_OFFLINE,
+        DEVICE_IDLE,
+        DEVICE_BUSY,
+    };
+
+    Q_ENUM(DevicePool::DeviceState)
+
+    explicit DevicePool(QObject *parent = nullptr);
+    ~DevicePool();
+
+    int addDevice(const QString& path, const QStringList& args, const QString& port);
+    void removeAll();
+    int deviceCount() const;
+    int onlineCount() const;
+    QString getPort(int device) const;
+    DeviceState getState(int device) const;
+
+    int submit(const QString& cmd, const Util::ReturnTrigger& trigger);
+    int submitToEach(const QString& cmd, const Util::ReturnTrigger& trigger);
+    void clearJobs();
+
+    void setProcEnv(const QStringList& env);
+    void setWorkingDir(const QString& dir);
+
+signals:
+    void deviceStateChanged(int device, DevicePool::DeviceState state, const QString& info);
+    void jobStarted(int jobId, int device, const QString& cmd);
+    void jobFinished(int jobId, int device, const QString& cmd, const QString& output, bool isResultFound);
+
+private:
+    struct Job
+    {
+        int id;
+        QString cmd;
+        Util::ReturnTrigger trigger;
+        int device; // the device it is pinned to, -1 for any device
+    };
+
+    struct Device
+    {
+        PM3Process* pm3;
+        QThread* thread;
+        QTimer* idleTimer;
+        QString port;
+        DeviceState state;
+        QList<Job> currJob; // empty or one job, Job has no default constructor
+        QString output;
+        int scannedLength;
+        bool isResultFound;
+    };
+
+    QList<Device*> devices;
+    QList<Job> jobQueue;
+    QStringList procEnv;
+    QString workingDir;
+    int nextJobId;
+
+    void dispatch();
+    void onOutput(int device, const QString& output);
+    void onStateChanged(int device, bool st, const QString& info);
+    void finishJob(int device, bool isDispatching = true);
+};
+
+#endif // DEVICEPOOL_H
@@ -0,0 +1,124 @@
+﻿#include "hexcodec.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HEXCODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+static const char hexDigits[16] = {'0', '1', '2', '3', '4', '5', '6', '7',
+                                   '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+                                  };
+
+static inline int hexValue(ushort c)
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    c |= 0x20; // 'A'-'F' -> 'a'-'f'
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+#ifdef HEXCODEC_SSE2
+// 8 bytes -> 16 characters
+static inline void encode8(const quint8* src, ushort* dst)
+{
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+    __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+    __m128i low = _mm_and_si128(bytes, mask);
+    __m128i nibbles = _mm_unpacklo_epi8(high, low); // the high nibble comes first
+    __m128i ascii = _mm_add_epi8(nibbles, _mm_set1_epi8('0'));
+    __m128i isAlpha = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    ascii = _mm_add_epi8(ascii, _mm_and_si128(isAlpha, _mm_set1_epi8('A' - '0' - 10)));
+    const __m128i zero = _mm_setzero_si128();
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi8(ascii, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8), _mm_unpackhi_epi8(ascii, zero));
+}
+
+// 16 characters -> 8 bytes, returns false if any character is not a hex digit
+static inline bool decode8(const ushort* src, quint8* dst)
+{
+    __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 8));
+    // characters out of Latin-1 saturate to 0x00 or 0xFF, which are rejected below
+    __m128i c = _mm_packus_epi16(first, second);
+    __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    // signed comparison, so bytes >= 0x80 are rejected as well
+    __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                    _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+    __m128i isAlpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                    _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    if(_mm_movemask_epi8(_mm_or_si128(isDigit, isAlpha)) != 0xFFFF)
+        return false;
+    __m128i value = _mm_or_si128(_mm_and_si128(isDigit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+                                 _mm_andnot_si128(isDigit, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    // every 16-bit lane holds two nibbles, the high one in the lower byte
+    __m128i high = _mm_slli_epi16(_mm_and_si128(value, _mm_set1_epi16(0x00FF)), 4);
+    __m128i low = _mm_srli_epi16(value, 8);
+    __m128i bytes = _mm_packus_epi16(_mm_or_si128(high, low), _mm_setzero_si128());
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), bytes);
+    return true;
+}
+#endif
+
+void HexCodec::encode(const quint8* data, int length, QChar* out)
+{
+    ushort* dst = reinterpret_cast<ushort*>(out);
+    int i = 0;
+#ifdef HEXCODEC_SSE2
+    for(; i + 8 <= length; i += 8)
+        encode8(data + i, dst + i * 2);
+#endif
+    for(; i < length; i++)
+    {
+        dst[i * 2] = hexDigits[data[i] >> 4];
+        dst[i * 2 + 1] = hexDigits[data[i] & 0x0F];
+    }
+}
+
+QString HexCodec::encode(const quint8* data, int length)
+{
+    QString result(length * 2, Qt::Uninitialized);
+    encode(data, length, result.data());
+    return result;
+}
+
+QString HexCodec::encode(const QByteArray& data)
+{
+    return encode(reinterpret_cast<const quint8*>(data.constData()), data.size());
+}
+
+bool HexCodec::decode(const QChar* text, int length, quint8* out)
+{
+    const ushort* src = reinterpret_cast<const ushort*>(text);
+    int i = 0;
+#ifdef HEXCODEC_SSE2
+    for(; i + 8 <= length; i += 8)
+    {
+        if(!decode8(src + i * 2, out + i))
+            return false;
+    }
+#endif
+    for(; i < length; i++)
+    {
+        int high = hexValue(src[i * 2]);
+        int low = hexValue(src[i * 2 + 1]);
+        if(high < 0 || low < 0)
+            return false;
+        out[i] = static_cast<quint8>((high << 4) | low);
+    }
+    return true;
+}
+
+QByteArray HexCodec::decode(const QString& text, bool* ok)
+{
+    QByteArray result(text.size() / 2, Qt::Uninitialized);
+    bool st = text.size() % 2 == 0
+              && decode(text.constData(), result.size(), reinterpret_cast<quint8*>(result.data()));
+    if(ok != nullptr)
+        *ok = st;
+    if(!st)
+        result.clear();
+    return result;
+}
@@ -0,0 +1,24 @@
+﻿#ifndef HEXCODEC_H
+#define HEXCODEC_H
+
+#include <QByteArray>
+#include <QChar>
+#include <QString>
+
+// Conversion between bytes and hex text.
+// SSE2 is used for 8 bytes at a time where the compiler supports it,
+// the remaining bytes go through the scalar code.
+class HexCodec
+{
+public:
+    // writes (length * 2) uppercase hex digits to out
+    static void encode(const quint8* data, int length, QChar* out);
+    static QString encode(const quint8* data, int length);
+    static QString encode(const QByteArray& data);
+    // reads (length * 2) hex digits without separators,
+    // returns false if any of them is not a hex digit(out is undefined then)
+    static bool decode(const QChar* text, int length, quint8* out);
+    static QByteArray decode(const QString& text, bool* ok = nullptr);
+};
+
+#endif // HEXCODEC_H
@@ -0,0 +1,229 @@
+﻿#include "keystore.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QVector>
+#include <algorithm>
+
+#include "log.h"
+
+bool KeyStore::open(const QString& path)
+{
+    this->path = path;
+    cards.clear();
+    globalHits.clear();
+
+    QFile file(path);
+    if(!file.exists())
+        return true;
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 fileMagic;
+    quint16 fileVersion;
+    in >> fileMagic >> fileVersion;
+    if(fileMagic != magic || fileVersion != version)
+    {
+        qCWarning(lcUtil) << "unknown key store file:" << path;
+        return false;
+    }
+
+    quint32 count;
+    in >> count;
+    for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++)
+    {
+        QByteArray uid;
+        quint8 sector, keyType;
+        CardKey item;
+        in >> uid >> sector >> keyType >> item.key >> item.hits >> item.lastSeen;
+        item.sector = sector;
+        item.keyType = static_cast<char>(keyType);
+        cards[uid].insert(static_cast<quint16>(sector << 1 | (keyType == 'B')), item);
+    }
+    in >> count;
+    for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++)
+    {
+        quint64 key;
+        quint32 keyHits;
+        in >> key >> keyHits;
+        globalHits.insert(key, keyHits);
+    }
+    if(in.status() != QDataStream::Ok)
+    {
+        qCWarning(lcUtil) << "truncated key store file:" << path;
+        return false;
+    }
+    return true;
+}
+
+bool KeyStore::save()
+{
+    if(path.isEmpty())
+        return false;
+    // written to a temporary file first, so a crash never leaves half a store
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << magic << version;
+
+    quint32 count = 0;
+    for(auto it = cards.cbegin(); it != cards.cend(); ++it)
+        count += it.value().size();
+    out << count;
+    // QMap iterates in order, so the table is sorted by UID, sector and key type
+    for(auto it = cards.cbegin(); it != cards.cend(); ++it)
+    {
+        for(const CardKey& item : it.value())
+            out << it.key() << static_cast<quint8>(item.sector) << static_cast<quint8>(item.keyType) << item.key << item.hits << item.lastSeen;
+    }
+    out << static_cast<quint32>(globalHits.size());
+    for(auto it = globalHits.cbegin(); it != globalHits.cend(); ++it)
+        out << it.key() << it.value();
+    return file.commit();
+}
+
+QString KeyStore::getPath() const
+{
+    return path;
+}
+
+bool KeyStore::record(const QByteArray& uid, int sector, char keyType, quint64 key)
+{
+    bool isNew = true;
+    globalHits[key]++;
+    if(uid.isEmpty())
+        return isNew;
+
+    CardKey& item = cards[uid][static_cast<quint16>(sector << 1 | (keyType == 'B'))];
+    if(item.hits > 0 && item.key == key)
+    {
+        item.hits++;
+        isNew = false;
+    }
+    else
+    {
+        item.sector = sector;
+        item.keyType = keyType;
+        item.key = key;
+        item.hits = 1;
+    }
+    item.lastSeen = QDateTime::currentMSecsSinceEpoch();
+    return isNew;
+}
+
+bool KeyStore::contains(const QByteArray& uid) const
+{
+    return cards.contains(uid);
+}
+
+QList<KeyStore::CardKey> KeyStore::cardKeys(const QByteArray& uid) const
+{
+    return cards.value(uid).values();
+}
+
+quint32 KeyStore::hits(quint64 key) const
+{
+    return globalHits.value(key, 0);
+}
+
+QList<quint64> KeyStore::topKeys(int count) const
+{
+    QList<quint64> result = globalHits.keys();
+    // stable, so keys with the same hits stay in a fixed order
+    std::stable_sort(result.begin(), result.end(), [this](quint64 a, quint64 b)
+    {
+        return globalHits[a] > globalHits[b];
+    });
+    if(count >= 0 && count < result.size())
+        result = result.mid(0, count);
+    return result;
+}
+
+QList<quint64> KeyStore::sectorKeys(int sector) const
+{
+    QMap<quint64, quint32> sectorHits;
+    for(auto it = cards.cbegin(); it != cards.cend(); ++it)
+    {
+        for(const CardKey& item : it.value())
+        {
+            if(item.sector == sector)
+                sectorHits[item.key] += item.hits;
+        }
+    }
+    QList<quint64> result = sectorHits.keys();
+    std::stable_sort(result.begin(), result.end(), [&sectorHits](quint64 a, quint64 b)
+    {
+        return sectorHits[a] > sectorHits[b];
+    });
+    return result;
+}
+
+QList<quint64> KeyStore::dictionary(const QByteArray& uid, int sectorCount) const
+{
+    // the order of a chk dictionary:
+    // 1. the keys of this card, if it has been seen
+    // 2. the n-th most frequent key of every sector, for n = 1, 2, ...
+    //    so the likely key of each sector comes early
+    // 3. the rest, by the hits over all cards
+    QList<quint64> result;
+    QSet<quint64> added;
+    auto add = [&result, &added](quint64 key)
+    {
+        if(!added.contains(key))
+        {
+            added.insert(key);
+            result.append(key);
+        }
+    };
+
+    for(const CardKey& item : cards.value(uid))
+        add(item.key);
+
+    QVector<QList<quint64>> ranks(sectorCount);
+    int maxRank = 0;
+    for(int i = 0; i < sectorCount; i++)
+    {
+        ranks[i] = sectorKeys(i);
+        maxRank = qMax(maxRank, ranks[i].size());
+    }
+    for(int rank = 0; rank < maxRank; rank++)
+    {
+        for(int i = 0; i < sectorCount; i++)
+        {
+            if(rank < ranks[i].size())
+                add(ranks[i][rank]);
+        }
+    }
+
+    for(quint64 key : topKeys())
+        add(key);
+    return result;
+}
+
+int KeyStore::cardCount() const
+{
+    return cards.size();
+}
+
+quint64 KeyStore::keyFromBytes(const quint8* bytes)
+{
+    quint64 key = 0;
+    for(int i = 0; i < 6; i++)
+        key = (key << 8) | bytes[i];
+    return key;
+}
+
+void KeyStore::keyToBytes(quint64 key, quint8* bytes)
+{
+    for(int i = 5; i >= 0; i--)
+    {
+        bytes[i] = key & 0xFF;
+        key >>= 8;
+    }
+}
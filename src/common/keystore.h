@@ -0,0 +1,49 @@
+﻿#ifndef KEYSTORE_H
+#define KEYSTORE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+// The keys recovered from the cards, kept across sessions.
+// Every key is recorded by UID, sector and key type with a hit count,
+// and the hits of each key over all cards are counted as well.
+// The file is a sorted binary table, loaded into memory at once.
+class KeyStore
+{
+public:
+    struct CardKey
+    {
+        int sector = 0;
+        char keyType = 'A';
+        quint64 key = 0; // 48 bits
+        quint32 hits = 0;
+        qint64 lastSeen = 0; // msecs since epoch
+    };
+
+    bool open(const QString& path); // an absent file is an empty store
+    bool save();
+    QString getPath() const;
+
+    // returns true if the key is new for this UID/sector/key type
+    bool record(const QByteArray& uid, int sector, char keyType, quint64 key);
+    bool contains(const QByteArray& uid) const;
+    QList<CardKey> cardKeys(const QByteArray& uid) const;
+    quint32 hits(quint64 key) const;
+    QList<quint64> topKeys(int count = -1) const; // by the hits over all cards, most first
+    QList<quint64> sectorKeys(int sector) const; // by the hits in this sector over all cards, most first
+    QList<quint64> dictionary(const QByteArray& uid, int sectorCount) const;
+    int cardCount() const;
+
+    static quint64 keyFromBytes(const quint8* bytes); // 6 bytes, MSB first
+    static void keyToBytes(quint64 key, quint8* bytes);
+private:
+    static const quint32 magic = 0x504D334B; // "PM3K"
+    static const quint16 version = 1;
+    QString path;
+    QMap<QByteArray, QMap<quint16, CardKey>> cards; // UID -> (sector << 1 | isKeyB) -> key
+    QMap<quint64, quint32> globalHits;
+};
+
+#endif // KEYSTORE_H
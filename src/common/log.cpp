@@ -0,0 +1,8 @@
+﻿#include "log.h"
+
+Q_LOGGING_CATEGORY(lcUtil, "pm3gui.util", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcProcess, "pm3gui.process", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcMifare, "pm3gui.mifare", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcLF, "pm3gui.lf", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcPool, "pm3gui.pool", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcUI, "pm3gui.ui", QtInfoMsg)
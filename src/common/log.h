@@ -0,0 +1,17 @@
+﻿#ifndef LOG_H
+#define LOG_H
+
+#include <QLoggingCategory>
+
+// Log categories, named "pm3gui.<module>".
+// Debug messages are disabled at runtime by default, enable them with
+// QT_LOGGING_RULES, e.g. QT_LOGGING_RULES="pm3gui.process.debug=true"
+// The levels below PM3GUI_LOG_LEVEL in Proxmark3GUI.pro are removed at compile time.
+Q_DECLARE_LOGGING_CATEGORY(lcUtil)
+Q_DECLARE_LOGGING_CATEGORY(lcProcess)
+Q_DECLARE_LOGGING_CATEGORY(lcMifare)
+Q_DECLARE_LOGGING_CATEGORY(lcLF)
+Q_DECLARE_LOGGING_CATEGORY(lcPool)
+Q_DECLARE_LOGGING_CATEGORY(lcUI)
+
+#endif // LOG_H
@@ -0,0 +1,79 @@
+﻿#include "patternset.h"
+
+#include "log.h"
+
+void PatternSet::clear()
+{
+    patterns.clear();
+    groupIndex.clear();
+    combined = QRegularExpression();
+}
+
+int PatternSet::add(const QString& pattern)
+{
+    patterns.append(pattern);
+    return patterns.size() - 1;
+}
+
+bool PatternSet::compile(QRegularExpression::PatternOptions options)
+{
+    // every pattern is wrapped in a group, so the matched one can be told by the group which has captured
+    QStringList wrapped;
+    int group = 1;
+    groupIndex.clear();
+    for(const QString& pattern : qAsConst(patterns))
+    {
+        QRegularExpression re(pattern);
+        if(!isSupported(pattern))
+        {
+            qCWarning(lcUtil) << "unsupported pattern:" << pattern << re.errorString();
+            wrapped.append("(?!)"); // never matches, but keeps the ids
+            groupIndex.append(group);
+            group += 1;
+            continue;
+        }
+        wrapped.append("(" + pattern + ")");
+        groupIndex.append(group);
+        group += 1 + re.captureCount();
+    }
+    combined = QRegularExpression(wrapped.join('|'), options);
+    combined.optimize();
+    return combined.isValid();
+}
+
+QList<PatternSet::Match> PatternSet::scan(const QString& text) const
+{
+    QList<Match> result;
+    if(patterns.isEmpty() || !combined.isValid())
+        return result;
+    QRegularExpressionMatchIterator it = combined.globalMatch(text);
+    while(it.hasNext())
+    {
+        QRegularExpressionMatch reMatch = it.next();
+        for(int i = 0; i < groupIndex.size(); i++)
+        {
+            if(reMatch.capturedStart(groupIndex[i]) == -1)
+                continue;
+            Match item;
+            item.id = i;
+            int nextGroup = (i + 1 < groupIndex.size()) ? groupIndex[i + 1] : combined.captureCount() + 1;
+            if(groupIndex[i] + 1 < nextGroup)
+                item.captured = reMatch.captured(groupIndex[i] + 1);
+            result.append(item);
+            break;
+        }
+    }
+    return result;
+}
+
+bool PatternSet::isEmpty() const
+{
+    return patterns.isEmpty();
+}
+
+bool PatternSet::isSupported(const QString& pattern)
+{
+    // a backslash which is not escaped, followed by a group number
+    static const QRegularExpression numberedRef("(?<!\\\\)(?:\\\\\\\\)*\\\\(?:[1-9]|g\\{?-?\\d)");
+    return QRegularExpression(pattern).isValid() && !numberedRef.match(pattern).hasMatch();
+}
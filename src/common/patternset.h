@@ -0,0 +1,34 @@
+﻿#ifndef PATTERNSET_H
+#define PATTERNSET_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QRegularExpression>
+
+// Several regular expressions compiled into one alternation,
+// so a text is scanned once no matter how many patterns there are.
+// Every pattern is wrapped in a group, which shifts the group numbers, so numbered backreferences(\1, \g{-1})
+// are not supported. Named ones(\k<name>) work if the names are unique in the set.
+class PatternSet
+{
+public:
+    struct Match
+    {
+        int id; // the index of the matched pattern
+        QString captured; // the first capturing group of the pattern, if any
+    };
+
+    void clear();
+    int add(const QString& pattern); // returns the id of the pattern
+    bool compile(QRegularExpression::PatternOptions options = QRegularExpression::NoPatternOption);
+    QList<Match> scan(const QString& text) const;
+    bool isEmpty() const;
+    static bool isSupported(const QString& pattern); // valid, and without numbered backreferences
+private:
+    QStringList patterns;
+    QList<int> groupIndex; // the capturing group of each pattern in the combined expression
+    QRegularExpression combined;
+};
+
+#endif // PATTERNSET_H
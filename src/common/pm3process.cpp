@@ -15,70 +15,191 @@ PM3Process::PM3Process(QThread *thread, QObject *parent) : QProcess(parent) {
   serialListener->setInterval(1000);
   serialListener->setTimerType(Qt::VeryCoarseTimer);
   connect(serialListener, &QTimer::timeout, this, &PM3Process::onTimeout);
+  // the output is merged and delivered at most once per flushInterval, so
+  // floods(sniff, trace list) don't queue a signal and a repaint per read
+  flushTimer = new QTimer();
+  flushTimer->moveToThread(this->thread());
+  flushTimer->setInterval(flushInterval);
+  flushTimer->setSingleShot(true);
+  flushTimer->setTimerType(Qt::PreciseTimer);
+  connect(flushTimer, &QTimer::timeout, this, &PM3Process::flushOutput);
+  decoder = QTextCodec::codecForName("UTF-8")->makeDecoder();
   connect(this, &PM3Process::readyRead, this, &PM3Process::onReadyRead);
+  connect(this, &PM3Process::started, this, &PM3Process::onStarted);
+  connect(this, &PM3Process::errorOccurred, this, &PM3Process::onProcessError);
+  connect(this, QOverload<int, QProcess::ExitStatus>::of(&PM3Process::finished),
+          this, &PM3Process::onFinished);
+  handshakeTimer = new QTimer();
+  handshakeTimer->moveToThread(this->thread());
+  handshakeTimer->setSingleShot(true);
+  connect(handshakeTimer, &QTimer::timeout, this,
+          &PM3Process::onHandshakeTimeout);
   portInfo = nullptr;
 
   qRegisterMetaType<QProcess::ProcessError>("QProcess::ProcessError");
 }
 
 void PM3Process::connectPM3(const QString &path, const QStringList args) {
-  QString result;
-  Util::ClientType clientType;
-  setRequiringOutput(true);
-
   // stash for reconnect
   currPath = path;
   currArgs = args;
+  isParking = false;
+  startClient(path, args);
+}
+
+void PM3Process::startClient(const QString &path, const QStringList &args) {
+  // The handshake doesn't block the thread, it's driven by started(),
+  // readyRead() and handshakeTimer:
+  // CONNECT_STARTING -> CONNECT_BANNER -> (RRG)CONNECT_VERSION -> connected
+  //                                    -> (standby)CONNECT_PARKED
+  setRequiringOutput(true);
+
+  // drop a partial character left by the previous client
+  pendingOutput.clear();
+  delete decoder;
+  decoder = QTextCodec::codecForName("UTF-8")->makeDecoder();
 
+  connectState = CONNECT_STARTING;
+  handshakeTimer->start(handshakeTimeout);
   // using "-f" option to make the client output flushed after every print.
   // single '\r' might appear. Don't use QProcess::Text there or '\r' is
   // ignored.
   start(path, args, QProcess::Unbuffered | QProcess::ReadWrite);
-  if (waitForStarted(10000)) {
-    waitForReadyRead(10000);
-    setRequiringOutput(false);
-    result = *requiredOutput;
-    if (result.contains("[=]")) {
-      clientType = Util::CLIENTTYPE_ICEMAN;
-      setRequiringOutput(true);
-      write("hw version\n");
-      for (int i = 0; i < 50; i++) {
-        waitForReadyRead(200);
-        result += *requiredOutput;
-        // 同时兼容老版的 "os: " 和新版的 "OS."
-        if (result.contains("os: ") ||
-            result.contains("OS.", Qt::CaseInsensitive))
-          break;
-      }
+}
+
+void PM3Process::onStarted() {
+  if (connectState != CONNECT_STARTING)
+    return;
+  connectState = CONNECT_BANNER;
+  handshakeTimer->start(handshakeTimeout);
+}
+
+void PM3Process::advanceHandshake() {
+  const QString &result = *requiredOutput;
+  if (connectState == CONNECT_BANNER) {
+    if (isParking) {
+      // wait until the banner tells the client type, promote() replays it
+      // and does the rest of the handshake
+      if (!result.contains("[=]") && !result.contains("os: ") &&
+          !result.contains("OS.", Qt::CaseInsensitive))
+        return;
+      standbyBanner = result;
+      connectState = CONNECT_PARKED;
+      handshakeTimer->stop();
       setRequiringOutput(false);
-    } else {
-      clientType = Util::CLIENTTYPE_OFFICIAL;
+      emit standbyStateChanged(true);
+      return;
     }
-    // 同时兼容老版的 "os: " 和新版的 "OS."
-    if (result.contains("os: ") ||
-        result.contains("OS.", Qt::CaseInsensitive)) {
-
-      emit changeClientType(clientType);
-
-      // 安全提取版本号，防止新版字符串格式变化导致数组越界崩溃
-      if (result.contains("os: ")) {
-        result = result.mid(result.indexOf("os: "));
-        result = result.left(result.indexOf("\n"));
-        result = result.mid(4, result.indexOf(" ", 4) - 4);
-      } else {
-        result = "RRG Latest"; // 如果是新版，右下角状态栏直接显示这个安全文本
-      }
-
-      emit PM3StatedChanged(true, result);
-    } else {
-      qDebug() << "unexpected output:"
-               << (result.isEmpty() ? "(empty)" : result);
-      emit HWConnectFailed();
-      kill();
+    if (result.contains("[=]")) {
+      handshakeClientType = Util::CLIENTTYPE_ICEMAN;
+      connectState = CONNECT_VERSION;
+      handshakeTimer->start(handshakeTimeout);
+      write("hw version\n");
+      return;
     }
+    handshakeClientType = Util::CLIENTTYPE_OFFICIAL;
   }
+  // the banner of the official client has the version, so it might be
+  // connected right away
+  // 同时兼容老版的 "os: " 和新版的 "OS."
+  if (result.contains("os: ") || result.contains("OS.", Qt::CaseInsensitive))
+    finishHandshake(result);
+}
 
+void PM3Process::finishHandshake(const QString &versionOutput) {
+  QString result = versionOutput;
+  connectState = CONNECT_IDLE;
+  handshakeTimer->stop();
   setRequiringOutput(false);
+  emit changeClientType(handshakeClientType);
+
+  // 安全提取版本号，防止新版字符串格式变化导致数组越界崩溃
+  if (result.contains("os: ")) {
+    result = result.mid(result.indexOf("os: "));
+    result = result.left(result.indexOf("\n"));
+    result = result.mid(4, result.indexOf(" ", 4) - 4);
+  } else {
+    result = "RRG Latest"; // 如果是新版，右下角状态栏直接显示这个安全文本
+  }
+
+  emit PM3StatedChanged(true, result);
+}
+
+void PM3Process::failHandshake() {
+  ConnectState failedState = connectState;
+  connectState = CONNECT_IDLE;
+  handshakeTimer->stop();
+  setRequiringOutput(false);
+  if (isParking) {
+    emit standbyStateChanged(false);
+  } else if (failedState != CONNECT_STARTING) {
+    // FailedToStart is reported by errorOccurred()
+    qCWarning(lcProcess) << "unexpected output:"
+             << (requiredOutput->isEmpty() ? "(empty)" : *requiredOutput);
+    emit HWConnectFailed();
+  }
+  kill();
+}
+
+void PM3Process::onHandshakeTimeout() {
+  // no banner, or no version in time
+  if (connectState != CONNECT_IDLE && connectState != CONNECT_PARKED)
+    failHandshake();
+}
+
+void PM3Process::onProcessError(QProcess::ProcessError error) {
+  if (error == QProcess::FailedToStart && connectState == CONNECT_STARTING)
+    failHandshake();
+}
+
+void PM3Process::onFinished() {
+  // the client exits during the handshake, or the parked client exits
+  if (connectState == CONNECT_PARKED) {
+    connectState = CONNECT_IDLE;
+    emit standbyStateChanged(false);
+  } else if (connectState != CONNECT_IDLE)
+    failHandshake();
+}
+
+void PM3Process::prepareStandby(const QString &path, const QStringList args,
+                                const QStringList env, const QString &dir) {
+  // start a spare client and park it after its banner, promote() finishes
+  // the handshake when it takes over
+  connectState = CONNECT_IDLE; // the old client is not reported
+  if (state() != QProcess::NotRunning) {
+    kill();
+    waitForFinished(1000);
+  }
+  currPath = path;
+  currArgs = args;
+  setEnvironment(env);
+  setWorkingDirectory(dir);
+  standbyBanner.clear();
+  isParking = true;
+  startClient(path, args);
+}
+
+void PM3Process::promote(const QString &connectCmd,
+                         const QStringList reconnectArgs) {
+  if (connectState != CONNECT_PARKED) {
+    emit HWConnectFailed();
+    return;
+  }
+  isParking = false;
+  // the output of the parked client is dropped, only the new output counts
+  flushTimer->stop();
+  pendingOutput.clear();
+  if (!reconnectArgs.isEmpty())
+    currArgs = reconnectArgs;
+  setRequiringOutput(true);
+  requiredOutput->append(standbyBanner);
+  connectState = CONNECT_BANNER;
+  handshakeTimer->start(handshakeTimeout);
+  // an offline client needs to connect to the hardware first, the command is
+  // queued before "hw version" so it's done when the version arrives
+  if (!connectCmd.isEmpty())
+    write(connectCmd + "\n");
+  advanceHandshake();
 }
 
 void PM3Process::reconnectPM3() { connectPM3(currPath, currArgs); }
@@ -98,7 +219,7 @@ void PM3Process::setSerialListener(const QString &name, bool state) {
     currPort = name;
     portInfo = new QSerialPortInfo(name);
     serialListener->start();
-    qDebug() << serialListener->thread();
+    qCDebug(lcProcess) << serialListener->thread();
   } else {
     serialListener->stop();
     if (portInfo != nullptr) {
@@ -125,12 +246,13 @@ void PM3Process::onTimeout() // when the proxmark3 client is unexpectedly
   //
   //    qDebug()<<portInfo->isBusy();
   if (!portInfo->isBusy()) {
+    emit clientLost();
     killPM3();
   }
 }
 
 void PM3Process::testThread() {
-  qDebug() << "PM3:" << QThread::currentThread();
+  qCDebug(lcProcess) << "PM3:" << QThread::currentThread();
 }
 
 qint64 PM3Process::write(QString data) {
@@ -138,15 +260,33 @@ qint64 PM3Process::write(QString data) {
 }
 
 void PM3Process::onReadyRead() {
-  QString out = readAll();
+  // the raw bytes are kept until the flush, then decoded once
+  QByteArray out = readAll();
   if (isRequiringOutput)
-    requiredOutput->append(out);
-  if (out != "") {
+    requiredOutput->append(QString::fromUtf8(out));
+  if (connectState == CONNECT_BANNER || connectState == CONNECT_VERSION)
+    advanceHandshake();
+  if (!out.isEmpty()) {
     //        qDebug() << "PM3Process::onReadyRead:" << out;
-    emit newOutput(out);
+    pendingOutput.append(out);
+    if (pendingOutput.size() >= flushSize)
+      flushOutput();
+    else if (!flushTimer->isActive())
+      flushTimer->start();
   }
 }
 
+void PM3Process::flushOutput() {
+  flushTimer->stop();
+  if (pendingOutput.isEmpty())
+    return;
+  // the decoder keeps a multi-byte character split between two reads
+  QString out = decoder->toUnicode(pendingOutput);
+  pendingOutput.clear();
+  if (!out.isEmpty())
+    emit newOutput(out);
+}
+
 void PM3Process::setProcEnv(const QStringList *env) {
   //    qDebug() << "passed Env List" << *env;
   this->setEnvironment(*env);
@@ -160,7 +300,13 @@ void PM3Process::setWorkingDir(const QString &dir) {
 }
 
 void PM3Process::killPM3() {
+  // a cancelled handshake is not a failure
+  connectState = CONNECT_IDLE;
+  handshakeTimer->stop();
+  flushOutput();
   kill();
+  // the serial port is free once the client has exited
+  waitForFinished(1000);
   emit PM3StatedChanged(false);
   setSerialListener(false);
 }
@@ -10,6 +10,8 @@
 #include <QtSerialPort/QSerialPort>
 #include <QProcessEnvironment>
 #include <QDir>
+#include <QTextCodec>
+#include <QTextDecoder>
 
 #include "util.h"
 
@@ -31,24 +33,57 @@ public slots:
     void setProcEnv(const QStringList* env);
     void setWorkingDir(const QString& dir);
     void killPM3();
+    void prepareStandby(const QString& path, const QStringList args, const QStringList env, const QString& dir);
+    void promote(const QString& connectCmd, const QStringList reconnectArgs);
 private slots:
     void onTimeout();
     void onReadyRead();
+    void flushOutput();
+    void onStarted();
+    void onFinished();
+    void onHandshakeTimeout();
+    void onProcessError(QProcess::ProcessError error);
 private:
+    enum ConnectState
+    {
+        CONNECT_IDLE, // not connecting, or connected
+        CONNECT_STARTING, // waiting for started()
+        CONNECT_BANNER, // waiting for the startup output
+        CONNECT_VERSION, // waiting for the output of "hw version"
+        CONNECT_PARKED, // a standby client, waiting for promote()
+    };
+    ConnectState connectState = CONNECT_IDLE;
+    bool isParking = false; // the client being started is a standby
+    Util::ClientType handshakeClientType = Util::CLIENTTYPE_OFFICIAL;
+    QTimer* handshakeTimer;
+    static const int handshakeTimeout = 10000; // ms, for every step
+
     bool isRequiringOutput;
     QString* requiredOutput; // It only works in this class now
     void setRequiringOutput(bool st);// It only works in this class now
+    void startClient(const QString& path, const QStringList& args);
+    void advanceHandshake();
+    void finishHandshake(const QString& versionOutput);
+    void failHandshake();
     QTimer* serialListener;
+    QTimer* flushTimer;
+    QByteArray pendingOutput; // read but not emitted yet
+    QTextDecoder* decoder; // UTF-8, stateful
+    static const int flushInterval = 20; // ms
+    static const int flushSize = 16384; // emit at once if this many bytes are pending
     QSerialPortInfo* portInfo;
     QString currPath;
     QString currPort = "";
     QStringList currArgs;
+    QString standbyBanner; // the startup output of a parked(standby) client
 
 signals:
     void PM3StatedChanged(bool st, const QString& info = "");
     void newOutput(const QString& output);
     void changeClientType(Util::ClientType);
     void HWConnectFailed();
+    void clientLost(); // the hardware is removed
+    void standbyStateChanged(bool isReady);
 };
 
 #endif // PM3PROCESS_H
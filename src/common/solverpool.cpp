@@ -0,0 +1,142 @@
+﻿#include "solverpool.h"
+
+SolverPool::SolverPool(QObject *parent) : QObject(parent)
+{
+    nextJobId = 0;
+    maxRunningCount = 1;
+}
+
+SolverPool::~SolverPool()
+{
+    killAll();
+}
+
+void SolverPool::setClient(const QString& path, const QStringList& args)
+{
+    clientPath = path;
+    clientArgs = args;
+}
+
+void SolverPool::setProcEnv(const QStringList& env)
+{
+    procEnv = env;
+}
+
+void SolverPool::setWorkingDir(const QString& dir)
+{
+    workingDir = dir;
+}
+
+void SolverPool::setKeyPattern(const QString& pattern)
+{
+    // like the other output recognizers, see MainWindow::setOutputPatterns()
+    keyPattern.setPattern(pattern);
+    keyPattern.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+    keyPattern.optimize();
+}
+
+void SolverPool::setMaxRunning(int count)
+{
+    maxRunningCount = qMax(1, count);
+    dispatch();
+}
+
+int SolverPool::maxRunning() const
+{
+    return maxRunningCount;
+}
+
+bool SolverPool::isReady() const
+{
+    return !clientPath.isEmpty() && !clientArgs.isEmpty();
+}
+
+int SolverPool::submit(const QString& uid, int sector, char keyType, const QString& file, const QString& cmd)
+{
+    for(const Job& job : jobQueue + runningJobs)
+    {
+        if(job.file == file)
+            return -1;
+    }
+    Job job = {nextJobId++, uid, sector, keyType, file, cmd, nullptr};
+    jobQueue.append(job);
+    dispatch();
+    return job.id;
+}
+
+int SolverPool::runningCount() const
+{
+    return runningJobs.size();
+}
+
+int SolverPool::queuedCount() const
+{
+    return jobQueue.size();
+}
+
+void SolverPool::clearJobs()
+{
+    jobQueue.clear();
+}
+
+void SolverPool::killAll()
+{
+    jobQueue.clear();
+    for(Job& job : runningJobs)
+    {
+        disconnect(job.process, nullptr, this, nullptr);
+        job.process->kill();
+        job.process->waitForFinished(1000);
+        delete job.process;
+    }
+    runningJobs.clear();
+}
+
+void SolverPool::dispatch()
+{
+    while(runningJobs.size() < maxRunningCount && !jobQueue.isEmpty() && isReady())
+    {
+        Job job = jobQueue.takeFirst();
+        QStringList args = clientArgs;
+        args.replaceInStrings("<cmd>", job.cmd);
+        job.process = new QProcess(this);
+        job.process->setProcessChannelMode(QProcess::MergedChannels);
+        if(!procEnv.isEmpty())
+            job.process->setEnvironment(procEnv);
+        job.process->setWorkingDirectory(workingDir);
+        int id = job.id;
+        connect(job.process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, [ = ]()
+        {
+            onFinished(id);
+        });
+        connect(job.process, &QProcess::errorOccurred, this, [ = ](QProcess::ProcessError error)
+        {
+            if(error == QProcess::FailedToStart)
+                onFinished(id);
+        });
+        runningJobs.append(job);
+        qCDebug(lcPool) << "solver" << id << "executing:" << job.cmd;
+        emit jobStarted(job.id, job.uid, job.sector, job.keyType);
+        job.process->start(clientPath, args);
+    }
+}
+
+void SolverPool::onFinished(int jobId)
+{
+    int i = 0;
+    while(i < runningJobs.size() && runningJobs[i].id != jobId)
+        i++;
+    if(i == runningJobs.size())
+        return;
+    Job job = runningJobs.takeAt(i);
+    QString output = QString::fromUtf8(job.process->readAll());
+    job.process->deleteLater();
+
+    QString key;
+    QRegularExpressionMatch match = keyPattern.match(output);
+    if(match.hasMatch())
+        key = match.captured(1).toUpper();
+    qCDebug(lcPool) << "solver" << jobId << "finished, key:" << key;
+    emit jobFinished(job.id, job.uid, job.sector, job.keyType, key, output);
+    dispatch();
+}
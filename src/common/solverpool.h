@@ -0,0 +1,70 @@
+﻿#ifndef SOLVERPOOL_H
+#define SOLVERPOOL_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QProcess>
+#include <QRegularExpression>
+
+#include "util.h"
+
+// Runs offline solvers(the client in offline mode, working on archived nonce files) in separate processes.
+// At most maxRunning() of them run at once, the others wait in the queue. It's 1 by default:
+// a hardnested solver already uses every core and a lot of memory.
+class SolverPool : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SolverPool(QObject *parent = nullptr);
+    ~SolverPool();
+
+    // args should contain <cmd>, which is replaced by the command of the job
+    void setClient(const QString& path, const QStringList& args);
+    void setProcEnv(const QStringList& env);
+    void setWorkingDir(const QString& dir);
+    void setKeyPattern(const QString& pattern); // the first captured group is the key
+    void setMaxRunning(int count);
+    int maxRunning() const;
+    bool isReady() const;
+
+    // returns -1 if the same file is already queued or running
+    int submit(const QString& uid, int sector, char keyType, const QString& file, const QString& cmd);
+    int runningCount() const;
+    int queuedCount() const;
+    void clearJobs();
+    void killAll();
+
+signals:
+    void jobStarted(int jobId, const QString& uid, int sector, char keyType);
+    // key is empty if the solver failed
+    void jobFinished(int jobId, const QString& uid, int sector, char keyType, const QString& key, const QString& output);
+
+private:
+    struct Job
+    {
+        int id;
+        QString uid;
+        int sector;
+        char keyType;
+        QString file;
+        QString cmd;
+        QProcess* process; // nullptr while queued
+    };
+
+    QList<Job> jobQueue;
+    QList<Job> runningJobs;
+    QString clientPath;
+    QStringList clientArgs;
+    QStringList procEnv;
+    QString workingDir;
+    QRegularExpression keyPattern;
+    int maxRunningCount;
+    int nextJobId;
+
+    void dispatch();
+    void onFinished(int jobId);
+};
+
+#endif // SOLVERPOOL_H
@@ -5,13 +5,23 @@ Util::ClientType Util::clientType = CLIENTTYPE_OFFICIAL;
 int Util::rawTabIndex = 0;
 QDockWidget* Util::rawDockPtr = nullptr;
 Ui::MainWindow* Util::ui = nullptr;
+const int Util::triggerOverlap;
 
 
 Util::Util(QObject *parent) : QObject(parent)
 {
     isRequiringOutput = false;
+    isRunning = false;
+    isResultFound = false;
     requiredOutput = new QString();
-    timeStamp = QTime::currentTime();
+    scannedLength = 0;
+    batchSize = 0;
+    currTrigger = nullptr;
+    waitLoop = nullptr;
+    waitTimer = nullptr;
+    cancelGeneration = 0;
+    prompt = "pm3 -->";
+    sentinelCount = 0;
     qRegisterMetaType<Util::ClientType>("Util::ClientType");
 }
 
@@ -22,62 +32,57 @@ void Util::processOutput(const QString& output)
     if(isRequiringOutput)
     {
         requiredOutput->append(output);
-        timeStamp = QTime::currentTime();
+        if(waitLoop != nullptr && batchSize > 0)
+        {
+            if(isBatchFinished())
+                waitLoop->quit();
+            else
+                waitTimer->start(static_cast<int>(currTrigger->waitTime));
+        }
+        else if(waitLoop != nullptr)
+        {
+            if(isTriggered())
+            {
+                isResultFound = true;
+                qCDebug(lcUtil) << "output Matched: " << *requiredOutput;
+                waitLoop->quit();
+            }
+            else // has new output, refresh the idle timeout
+                waitTimer->start(static_cast<int>(currTrigger->waitTime));
+        }
     }
     emit refreshOutput(output);
 }
 
 void Util::execCMD(const QString& cmd)
 {
-    qDebug() << "executing: " << cmd;
+    qCDebug(lcUtil) << "executing: " << cmd;
     if(isRunning)
         emit write(cmd + "\n");
 }
 
 QString Util::execCMDWithOutput(const QString& cmd, ReturnTrigger trigger, bool rawOutput)
 {
-    // if the trigger is empty, this function will wait trigger.waitTime then return all outputs during the wait time.
+    // if the trigger is empty, this function will return as soon as the response is complete(see below),
+    // or wait trigger.waitTime then return all outputs during the wait time.
     // otherwise, this function will return empty string if no trigger is detected, or return outputs if any trigger is detected.
     // the waitTime will be refreshed if the client have new outputs
-    bool isResultFound = false;
-    QRegularExpression re;
-    re.setPatternOptions(QRegularExpression::DotMatchesEverythingOption);
 
     if(!isRunning)
         return "";
-    QTime currTime = QTime::currentTime();
-    QTime targetTime = QTime::currentTime().addMSecs(trigger.waitTime);
-    isRequiringOutput = true;
-    requiredOutput->clear();
-    execCMD(cmd);
-    while(QTime::currentTime() < targetTime)
+    if(trigger.expectedOutputs.isEmpty() && isFramed())
     {
-        if(!isRunning)
-            break;
-        QApplication::processEvents();
-//        qDebug() << "currOutput:" << *requiredOutput;
-        for(QString otpt : trigger.expectedOutputs)
-        {
-            re.setPattern(otpt);
-            isResultFound = re.match(*requiredOutput).hasMatch();
-            if(isResultFound)
-            {
-                qDebug() << "output Matched: " << *requiredOutput;
-                break;
-            }
-        }
-        if(isResultFound)
-        {
-            delay(200);
-            break;
-        }
-        if(timeStamp > currTime) //has new output
-        {
-            currTime = timeStamp;
-            targetTime = timeStamp.addMSecs(trigger.waitTime);
-        }
+        // Short commands(rdbl, rdsc, info...) are framed by the prompt,
+        // the waitTime is only a ceiling for clients which don't echo the commands.
+        // Commands with expected outputs are not framed, because the sentinel line
+        // would abort long-running commands like chk or nested, which stop on Enter.
+        return execCMDsWithOutput({cmd}, trigger.waitTime).first();
     }
-    isRequiringOutput = false;
+    qCDebug(lcUtil) << "executing: " << cmd;
+    CancelToken token = cancelGeneration;
+    waitForOutput(cmd + "\n", &trigger, 0);
+    if(isCancelled(token))
+        return "";
 
     // For functions without expected outputs in the return trigger, the result is the raw output.
     // For functions with expected outputs in the return trigger,
@@ -87,11 +92,216 @@ QString Util::execCMDWithOutput(const QString& cmd, ReturnTrigger trigger, bool
     return (trigger.expectedOutputs.isEmpty() || isResultFound || rawOutput ? *requiredOutput : "");
 }
 
+QStringList Util::execCMDsWithOutput(const QStringList& cmds, unsigned long waitTime)
+{
+    // Write all commands to the client at once, then split the merged output into one response per command.
+    // The client echoes every non-empty line it reads from the pipe after the prompt("[usb] pm3 --> hf mf rdbl ..."),
+    // so the text between two echoes is the response of the former command.
+    // A no-op command with a unique tag("rem <token>" on RRG) is appended as a sentinel,
+    // its echo marks the end of the last response.
+    // waitTime is only the idle timeout, like execCMDWithOutput().
+    QStringList result;
+    for(int i = 0; i < cmds.size(); i++)
+        result.append("");
+    if(!isRunning || cmds.isEmpty())
+        return result;
+
+    ReturnTrigger trigger(waitTime);
+    CancelToken token = cancelGeneration;
+    if(!isFramed())
+    {
+        // without a sentinel the responses can't be told apart, each command waits for its idle timeout
+        for(int i = 0; i < cmds.size(); i++)
+        {
+            qCDebug(lcUtil) << "executing: " << cmds[i];
+            waitForOutput(cmds[i] + "\n", &trigger, 0);
+            if(isCancelled(token))
+                break;
+            result[i] = *requiredOutput;
+        }
+        return result;
+    }
+    qCDebug(lcUtil) << "executing: " << cmds;
+    sentinel = newSentinel();
+    waitForOutput(cmds.join("\n") + "\n" + sentinel + "\n", &trigger, cmds.size());
+    // the output might belong to abortCMD() then
+    if(isCancelled(token))
+        return result;
+
+    // every command and the sentinel are echoed once, the text between two echoes is a response
+    if(isBatchFinished() && promptPos.size() == cmds.size() + 1)
+    {
+        for(int i = 0; i < cmds.size(); i++)
+        {
+            int start = requiredOutput->indexOf('\n', promptPos[i]) + 1;
+            int end = requiredOutput->lastIndexOf('\n', promptPos[i + 1]) + 1;
+            if(start > 0 && end > start)
+                result[i] = requiredOutput->mid(start, end - start);
+        }
+        return result;
+    }
+    // a single command gets the whole output
+    if(cmds.size() == 1)
+    {
+        result[0] = *requiredOutput;
+        return result;
+    }
+    // Otherwise(no echo, a prompt which doesn't match, or a timeout), the output can't be split.
+    // The commands run again one by one, so an empty response still means the command printed nothing.
+    qCInfo(lcUtil) << "the output of the batch can't be split, run the commands one by one";
+    for(int i = 0; i < cmds.size(); i++)
+    {
+        result[i] = execCMDsWithOutput({cmds[i]}, waitTime).first();
+        if(isCancelled(token))
+            break;
+    }
+    return result;
+}
+
+void Util::waitForOutput(const QString& data, const ReturnTrigger* trigger, int batch)
+{
+    // The caller is suspended in a local event loop, which is woken up by processOutput(), the idle timer or the state change,
+    // so nothing is polled while waiting.
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    connect(&timer, &QTimer::timeout, &loop, &QEventLoop::quit);
+    // a nested call (from a slot running inside this loop) must hand the wait back to the outer call
+    const ReturnTrigger* prevTrigger = currTrigger;
+    QEventLoop* prevLoop = waitLoop;
+    QTimer* prevTimer = waitTimer;
+    int prevBatchSize = batchSize;
+    CancelToken token = cancelGeneration;
+
+    isResultFound = false;
+    isRequiringOutput = true;
+    requiredOutput->clear();
+    scannedLength = 0;
+    promptPos.clear();
+    currTrigger = trigger;
+    batchSize = batch;
+    waitLoop = &loop;
+    waitTimer = &timer;
+    timer.start(static_cast<int>(trigger->waitTime));
+    emit write(data);
+    loop.exec();
+    timer.stop();
+    waitLoop = nullptr;
+    waitTimer = nullptr;
+    currTrigger = nullptr;
+    if(isResultFound && !isCancelled(token))
+        delay(200); // collect the rest of the matched output
+    isRequiringOutput = (prevLoop != nullptr);
+    currTrigger = prevTrigger;
+    batchSize = prevBatchSize;
+    waitLoop = prevLoop;
+    waitTimer = prevTimer;
+    // cancel() only wakes up the innermost wait, pass it to the outer one
+    if(isCancelled(token))
+    {
+        isResultFound = false;
+        if(prevLoop != nullptr)
+            prevLoop->quit();
+    }
+}
+
+bool Util::isFramed() const
+{
+    return !prompt.isEmpty() && !sentinelCmd.isEmpty();
+}
+
+QString Util::newSentinel()
+{
+    // fixed width, so one token is never the prefix of another
+    return sentinelCmd + " pm3gui-" + QString("%1").arg(++sentinelCount, 8, 16, QChar('0'));
+}
+
+bool Util::isBatchFinished()
+{
+    // record where each echoed command starts, the batch is finished once the sentinel is echoed after the last one
+    if(!isFramed())
+        return false;
+    int from = qMax(0, scannedLength - prompt.length() + 1);
+    int sentinelFrom = qMax(0, scannedLength - sentinel.length() + 1);
+    int pos;
+    while((pos = requiredOutput->indexOf(prompt, from)) != -1)
+    {
+        promptPos.append(pos);
+        from = pos + prompt.length();
+    }
+    scannedLength = qMax(from, requiredOutput->length());
+    if(promptPos.isEmpty())
+        return false;
+    return requiredOutput->indexOf(sentinel, qMax(sentinelFrom, promptPos.last())) != -1;
+}
+
+bool Util::isTriggered()
+{
+    // only scan the new output and a bounded window before it, so the cost of each chunk
+    // doesn't grow with the length of the whole output
+    int from = qMax(0, scannedLength - triggerOverlap);
+    scannedLength = requiredOutput->length();
+    return currTrigger->isMatched(requiredOutput->midRef(from));
+}
+
 void Util::delay(unsigned int msec)
 {
-    QTime timer = QTime::currentTime().addMSecs(msec);
-    while(QTime::currentTime() < timer)
-        QApplication::processEvents(QEventLoop::AllEvents, 100);
+    QEventLoop loop;
+    QTimer::singleShot(msec, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+void Util::setConfigMap(const QVariantMap& configMap)
+{
+    // an empty prompt disables the framing, then every command waits for its idle timeout
+    prompt = configMap.value("prompt", "pm3 -->").toString();
+    sentinelCmd = configMap.value("sentinel", "").toString();
+}
+
+QString Util::getPrompt() const
+{
+    return prompt;
+}
+
+Util::CancelToken Util::cancelToken() const
+{
+    return cancelGeneration;
+}
+
+bool Util::isCancelled(CancelToken token) const
+{
+    return token != cancelGeneration;
+}
+
+void Util::cancel()
+{
+    // the running wait returns at once with what it has got, and the loops holding an older token stop
+    cancelGeneration++;
+    if(waitLoop != nullptr)
+        waitLoop->quit();
+}
+
+bool Util::abortCMD(unsigned long waitTime)
+{
+    // Most long-running commands of the client(chk, nested, sniff...) stop on Enter, then it goes back to the prompt.
+    // The client doesn't echo empty lines, so a tagged sentinel follows the Enter, its echo shows the client reads commands again.
+    // The stopping command might drain all pending input, so both are sent repeatedly until the echo appears.
+    // Returns false if the client doesn't respond in waitTime, the caller should restart it then.
+    if(!isRunning || !isFramed())
+        return false;
+    const unsigned long interval = 500;
+    sentinel = newSentinel();
+    ReturnTrigger trigger(interval, {QRegularExpression::escape(sentinel)});
+    QElapsedTimer elapsedTimer;
+    elapsedTimer.start();
+    while(static_cast<unsigned long>(elapsedTimer.elapsed()) < waitTime)
+    {
+        waitForOutput("\n" + sentinel + "\n", &trigger, 0);
+        if(isResultFound)
+            return true;
+    }
+    qCInfo(lcUtil) << "the client doesn't respond to Enter";
+    return false;
 }
 
 Util::ClientType Util::getClientType()
@@ -107,6 +317,8 @@ void Util::setClientType(Util::ClientType clientType)
 void Util::setRunningState(bool st)
 {
     this->isRunning = st;
+    if(!isRunning && waitLoop != nullptr)
+        waitLoop->quit();
 }
 
 bool Util::chooseLanguage(QSettings* guiSettings, QMainWindow* window)
@@ -8,6 +8,7 @@
 #include <QApplication>
 #include <QTime>
 #include <QTimer>
+#include <QEventLoop>
 #include <QMetaType>
 #include <QRegularExpression>
 #include <QSettings>
@@ -15,8 +16,10 @@
 #include <QInputDialog>
 #include <QFileDialog>
 #include <QDockWidget>
+#include <QElapsedTimer>
 
 #include "ui_mainwindow.h"
+#include "log.h"
 
 class Util : public QObject
 {
@@ -32,6 +35,7 @@ public:
     {
         unsigned long waitTime;
         QStringList expectedOutputs;
+        QList<QRegularExpression> patterns; // compiled from expectedOutputs once, reused for every output chunk
         ReturnTrigger(unsigned long time)
         {
             waitTime = time;
@@ -41,27 +45,63 @@ public:
         {
             waitTime = 10000;
             expectedOutputs = outputs;
+            compile();
         }
         ReturnTrigger(unsigned long time, const QStringList& outputs)
         {
             waitTime = time;
             expectedOutputs = outputs;
+            compile();
+        }
+        bool isMatched(const QStringRef& text) const
+        {
+            for(const QRegularExpression& re : patterns)
+            {
+                if(re.match(text).hasMatch())
+                    return true;
+            }
+            return false;
+        }
+    private:
+        void compile()
+        {
+            patterns.clear();
+            for(const QString& otpt : expectedOutputs)
+            {
+                QRegularExpression re(otpt, QRegularExpression::DotMatchesEverythingOption);
+                re.optimize();
+                patterns.append(re);
+            }
         }
     };
 
+    // Expected outputs are matched against the newly appended text plus this many characters before it,
+    // so a pattern split between two chunks is still found.
+    static const int triggerOverlap = 256;
+
+    // A loop of commands keeps the token it started with, and stops once the token is cancelled.
+    typedef quint32 CancelToken;
+
     Q_ENUM(Util::ClientType)
 
     explicit Util(QObject *parent = nullptr);
 
     void execCMD(const QString& cmd);
     QString execCMDWithOutput(const QString& cmd, ReturnTrigger trigger = 10000, bool rawOutput = false);
+    QStringList execCMDsWithOutput(const QStringList& cmds, unsigned long waitTime = 10000);
     void delay(unsigned int msec);
+    void setConfigMap(const QVariantMap& configMap);
     static ClientType getClientType();
+    QString getPrompt() const;
+    CancelToken cancelToken() const;
+    bool isCancelled(CancelToken token) const;
+    bool abortCMD(unsigned long waitTime = 3000);
     static int rawTabIndex;
     static QDockWidget* rawDockPtr;
     static bool chooseLanguage(QSettings *guiSettings, QMainWindow *window = nullptr);
 public slots:
     void processOutput(const QString& output);
+    void cancel();
     static void setClientType(Util::ClientType clientType);
     void setRunningState(bool st);
     static void gotoRawTab();
@@ -70,8 +110,24 @@ public slots:
 private:
     bool isRequiringOutput;
     bool isRunning;
+    bool isResultFound;
     QString* requiredOutput;
-    QTime timeStamp;
+    int scannedLength; // the part of requiredOutput already checked by isTriggered() or isBatchFinished()
+    int batchSize; // number of commands sent by execCMDsWithOutput(), 0 for a single command
+    QList<int> promptPos; // where the echoed commands start in requiredOutput
+    QString prompt; // from the "client" part of the config file
+    QString sentinelCmd; // from the "client" part of the config file, "" disables the framing
+    QString sentinel; // the tagged sentinel of the running batch, like "rem pm3gui-0000002a"
+    quint32 sentinelCount;
+    const ReturnTrigger* currTrigger; // only valid while execCMDWithOutput() is waiting
+    QEventLoop* waitLoop; // the loop execCMDWithOutput() is sleeping in, nullptr if not waiting
+    QTimer* waitTimer;
+    CancelToken cancelGeneration; // increased by cancel(), the older tokens are cancelled
+    bool isTriggered();
+    bool isFramed() const;
+    QString newSentinel();
+    bool isBatchFinished();
+    void waitForOutput(const QString& data, const ReturnTrigger* trigger, int batch);
     static ClientType clientType;
     static Ui::MainWindow *ui;
 signals:
@@ -0,0 +1,189 @@
+﻿#include "cardimage.h"
+
+#include "common/hexcodec.h"
+
+CardImage::Bytes::Bytes() {
+    memset(data, 0, sizeof(data));
+    unknown = 0;
+    length = 0;
+}
+
+bool CardImage::Bytes::isEmpty() const { return length == 0; }
+
+bool CardImage::Bytes::isKnown() const { return length != 0 && unknown == 0; }
+
+bool CardImage::Bytes::isNibbleKnown(int i) const {
+    return !(unknown & (1u << i));
+}
+
+QString CardImage::Bytes::toText() const {
+    QString result = HexCodec::encode(data, length);
+    if (unknown != 0) {
+        for (int i = 0; i < length * 2; i++) {
+            if (!isNibbleKnown(i))
+                result[i] = '?';
+        }
+    }
+    return result;
+}
+
+QString CardImage::Bytes::byteText(int i) const {
+    QString result = HexCodec::encode(data + i, 1);
+    if (!isNibbleKnown(i * 2))
+        result[0] = '?';
+    if (!isNibbleKnown(i * 2 + 1))
+        result[1] = '?';
+    return result;
+}
+
+bool CardImage::Bytes::matches(const Bytes &other) const {
+    if (length != other.length)
+        return false;
+    quint32 mask = unknown | other.unknown;
+    for (int i = 0; i < length; i++) {
+        quint8 diff = data[i] ^ other.data[i];
+        if ((diff & 0xF0) && !(mask & (1u << (i * 2))))
+            return false;
+        if ((diff & 0x0F) && !(mask & (1u << (i * 2 + 1))))
+            return false;
+    }
+    return true;
+}
+
+bool CardImage::Bytes::operator==(const Bytes &other) const {
+    return length == other.length && unknown == other.unknown &&
+           memcmp(data, other.data, length) == 0;
+}
+
+bool CardImage::Bytes::operator!=(const Bytes &other) const {
+    return !(*this == other);
+}
+
+CardImage::Bytes CardImage::Bytes::fromText(const QString &text, int length) {
+    return fromText(QStringRef(&text), length);
+}
+
+CardImage::Bytes CardImage::Bytes::fromText(const QStringRef &text, int length) {
+    Bytes result;
+    if (length <= 0 || length > 16)
+        return result;
+    // drop the separators, then decode all the digits at once
+    QChar digits[32];
+    int nibbleCount = 0;
+    for (const QChar &ch : text) {
+        ushort c = ch.unicode();
+        if (c == ' ' || c == '\r' || c == '\n' || c == '\t')
+            continue;
+        if (nibbleCount >= length * 2)
+            return Bytes();
+        digits[nibbleCount++] = ch;
+    }
+    if (nibbleCount != length * 2)
+        return Bytes();
+    result.length = length;
+    if (HexCodec::decode(digits, length, result.data))
+        return result;
+
+    // not plain hex, '?' stands for an unknown nibble
+    memset(result.data, 0, sizeof(result.data));
+    for (int i = 0; i < nibbleCount; i++) {
+        ushort c = digits[i].unicode();
+        quint8 value;
+        if (c >= '0' && c <= '9')
+            value = c - '0';
+        else if (c >= 'A' && c <= 'F')
+            value = c - 'A' + 10;
+        else if (c >= 'a' && c <= 'f')
+            value = c - 'a' + 10;
+        else if (c == '?') {
+            value = 0;
+            result.unknown |= 1u << i;
+        } else
+            return Bytes();
+        result.data[i / 2] |= (i % 2) ? value : (value << 4);
+    }
+    return result;
+}
+
+CardImage::Bytes CardImage::Bytes::fromRaw(const char *raw, int length) {
+    Bytes result;
+    memcpy(result.data, raw, length);
+    result.length = length;
+    return result;
+}
+
+CardImage::Bytes CardImage::Bytes::unknownBytes(int length) {
+    Bytes result;
+    result.length = length;
+    result.unknown = (length * 2 == 32) ? 0xFFFFFFFFu : ((1u << (length * 2)) - 1);
+    return result;
+}
+
+CardImage::CardImage() {}
+
+void CardImage::resize(int blockCount, int sectorCount) {
+    blocks.resize(blockCount);
+    keyA.resize(sectorCount);
+    keyB.resize(sectorCount);
+}
+
+void CardImage::clearData() { blocks.fill(Bytes()); }
+
+void CardImage::clearKeys() {
+    keyA.fill(Bytes());
+    keyB.fill(Bytes());
+}
+
+int CardImage::blockCount() const { return blocks.size(); }
+
+int CardImage::sectorCount() const { return keyA.size(); }
+
+CardImage::Bytes &CardImage::block(int id) { return blocks[id]; }
+
+const CardImage::Bytes &CardImage::block(int id) const { return blocks[id]; }
+
+CardImage::Bytes &CardImage::key(int sector, char keyType) {
+    return keyType == 'B' ? keyB[sector] : keyA[sector];
+}
+
+const CardImage::Bytes &CardImage::key(int sector, char keyType) const {
+    return keyType == 'B' ? keyB[sector] : keyA[sector];
+}
+
+QString CardImage::blockText(int id) const { return blocks[id].toText(); }
+
+void CardImage::setBlockText(int id, const QString &text) {
+    blocks[id] = Bytes::fromText(text, 16);
+}
+
+QString CardImage::keyText(int sector, char keyType) const {
+    return key(sector, keyType).toText();
+}
+
+void CardImage::setKeyText(int sector, char keyType, const QString &text) {
+    key(sector, keyType) = Bytes::fromText(text, 6);
+}
+
+void CardImage::writeBlocks(QByteArray &buff) const {
+    for (const Bytes &item : blocks) {
+        if (item.isEmpty())
+            buff.append(16, '\0');
+        else
+            buff.append(reinterpret_cast<const char *>(item.data), 16);
+    }
+}
+
+void CardImage::writeKeys(QByteArray &buff) const {
+    for (const Bytes &item : keyA) {
+        if (item.isEmpty())
+            buff.append(6, '\0');
+        else
+            buff.append(reinterpret_cast<const char *>(item.data), 6);
+    }
+    for (const Bytes &item : keyB) {
+        if (item.isEmpty())
+            buff.append(6, '\0');
+        else
+            buff.append(reinterpret_cast<const char *>(item.data), 6);
+    }
+}
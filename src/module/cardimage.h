@@ -0,0 +1,64 @@
+﻿#ifndef CARDIMAGE_H
+#define CARDIMAGE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <cstring>
+
+// The data and keys of a MIFARE Classic card, kept as raw bytes.
+// Every nibble has an "unknown" bit, which is shown as '?' in the UI.
+// Hex text is only produced or parsed at the UI/client boundary.
+class CardImage {
+public:
+  struct Bytes {
+    quint8 data[16];
+    quint32 unknown; // bit i is set if the i-th nibble is unknown
+    quint8 length;   // 0 means empty(never read), 6 for a key, 16 for a block
+
+    Bytes();
+    bool isEmpty() const;
+    bool isKnown() const; // not empty, and no unknown nibble
+    bool isNibbleKnown(int i) const;
+    QString toText() const;
+    QString byteText(int i) const;
+    bool matches(const Bytes &other) const; // unknown nibbles match anything
+    bool operator==(const Bytes &other) const;
+    bool operator!=(const Bytes &other) const;
+
+    // spaces are ignored, returns an empty Bytes if the text is not
+    // (length * 2) hex digits or '?'
+    static Bytes fromText(const QString &text, int length);
+    static Bytes fromText(const QStringRef &text, int length);
+    static Bytes fromRaw(const char *raw, int length);
+    static Bytes unknownBytes(int length); // all nibbles are unknown
+  };
+
+  CardImage();
+
+  void resize(int blockCount, int sectorCount); // new blocks and keys are empty
+  void clearData();
+  void clearKeys();
+  int blockCount() const;
+  int sectorCount() const;
+
+  Bytes &block(int id);
+  const Bytes &block(int id) const;
+  Bytes &key(int sector, char keyType); // keyType: 'A' or 'B'
+  const Bytes &key(int sector, char keyType) const;
+
+  QString blockText(int id) const;
+  void setBlockText(int id, const QString &text);
+  QString keyText(int sector, char keyType) const;
+  void setKeyText(int sector, char keyType, const QString &text);
+
+  void writeBlocks(QByteArray &buff) const; // unknown nibbles are written as 0
+  void writeKeys(QByteArray &buff) const;   // all KeyA, then all KeyB
+
+private:
+  QVector<Bytes> blocks;
+  QVector<Bytes> keyA;
+  QVector<Bytes> keyB;
+};
+
+#endif // CARDIMAGE_H
@@ -66,7 +66,7 @@ bool LF::getLFConfig_helper(const QVariantMap& map, QString& str, int* result)
     if(!reMatch.hasMatch())
         return false;
     *result = reMatch.captured().toInt();
-    qDebug() << *result;
+    qCDebug(lcLF) << *result;
     return true;
 
 }
@@ -91,7 +91,7 @@ void LF::getLFConfig()
 #else
     resultList = result.split("\n", Qt::SkipEmptyParts);
 #endif
-    qDebug() << "LF CONFIG GET\n" << resultList;
+    qCDebug(lcLF) << "LF CONFIG GET\n" << resultList;
     for(auto it = resultList.begin(); it != resultList.end(); it++)
     {
         if(getLFConfig_helper(config["divisor"].toMap(), *it, &temp))
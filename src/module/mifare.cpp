@@ -1,5 +1,7 @@
 ﻿#include "mifare.h"
+#include "common/hexcodec.h"
 #include <QJsonArray>
+#include <algorithm>
 #include <QBrush>
 #include <QColor>
 #include <QDialog>
@@ -10,6 +12,7 @@
 #include <QDialogButtonBox>
 #include <QSpinBox>
 #include <QComboBox>
+#include <QCheckBox>
 #include <QLineEdit>
 #include <QLabel>
 #include <QTextBrowser>
@@ -83,11 +86,10 @@ Mifare::Mifare(Ui::MainWindow *ui, Util *addr, QWidget *parent)
     util = addr;
     this->ui = ui;
     cardType = card_1k;
-    keyAList = new QStringList();
-    keyBList = new QStringList();
-    dataList = new QStringList();
-    data_clearKey();  // fill with blank QString
-    data_clearData(); // fill with blank QString
+    image = new CardImage();
+    keyStore = new KeyStore();
+    data_clearKey();  // fill with empty keys
+    data_clearData(); // fill with empty blocks
     dataPattern = new QRegularExpression("([0-9a-fA-F]{2} ){15}[0-9a-fA-F]{2}");
     keyPattern_res =
         new QRegularExpression("\\|\\s*\\d{3}\\s*\\|\\s*.+?\\s*\\|\\s*.+?\\s*\\|"
@@ -127,56 +129,107 @@ QMap<QString, QString> Mifare::info(bool isRequiringOutput) {
                                  .remove(QRegularExpression("[^0-9a-fA-F]"))
                                  .trimmed();
         }
+        // another card is placed, the read results of the last one are useless
+        if (map["UID"] != currUID) {
+            resetReadCache();
+            currUID = map["UID"];
+        }
     } else {
         util->execCMD(config["cmd"].toString());
         Util::gotoRawTab();
+        resetReadCache();
     }
     return map;
 }
 
 void Mifare::chk() {
+    if (useStoredKeys())
+        return;
     Util::gotoRawTab(); // <--- 新增：一开始就跳到控制台看进度
-    QRegularExpressionMatch reMatch;
-    QString result;
-    int offset = 0;
-    QString data;
-    QVariantMap config = configMap["check"].toMap();
-    QString cmd = config["cmd"].toString();
-    int keyAindex = config["key A index"].toInt();
-    int keyBindex = config["key B index"].toInt();
-    QRegularExpression keyPattern = QRegularExpression(
-        config["key pattern"].toString(), QRegularExpression::MultilineOption);
-    cmd.replace("<card type>",
-                config["card type"].toMap()[cardType.typeText].toString());
+    QString cmd = chkCmd();
+    // the keys are filled by data_parseKeyRows() while chk is running
+    startKeyRows("check", cmd);
+    util->execCMDWithOutput(cmd, chkTrigger());
+}
 
-    result = util->execCMDWithOutput(
-        cmd, Util::ReturnTrigger(1000 + cardType.sector_size * 200,
-                            {"No valid", keyPattern.pattern()}));
-    for (int i = 0; i < cardType.sector_size; i++) {
-        reMatch = keyPattern.match(result, offset);
-        offset = reMatch.capturedStart();
-        if (reMatch.hasMatch()) {
-            data = reMatch.captured().toUpper();
-            offset += data.length();
-            QStringList cells = data.remove(" ").split("|");
-            if (!cells[keyAindex].contains(QRegularExpression("[^0-9a-fA-F]"))) {
-                keyAList->replace(i, cells[keyAindex]);
-            }
-            if (!cells[keyBindex].contains(QRegularExpression("[^0-9a-fA-F]"))) {
-                keyBList->replace(i, cells[keyBindex]);
+void Mifare::startKeyRows(const QString &section, const QString &cmd) {
+    QVariantMap config = configMap[section].toMap();
+    keyRowPattern = QRegularExpression(config["key pattern"].toString(),
+                                       QRegularExpression::MultilineOption);
+    keyRowPattern.optimize();
+    keyRowAIndex = config["key A index"].toInt();
+    keyRowBIndex = config["key B index"].toInt();
+    keyRowCmd = cmd;
+    keyRowCount = 0;
+}
+
+void Mifare::data_parseKeyRows(const QString &lines) {
+    // called with every batch of complete lines from the client.
+    // The parsing stops at the echo of the next command.
+    if (keyRowCmd.isEmpty())
+        return;
+    const QString prompt = util->getPrompt();
+    int storedCount = 0;
+#if (QT_VERSION <= QT_VERSION_CHECK(5, 14, 0))
+    const QVector<QStringRef> lineList = lines.splitRef('\n', QString::SkipEmptyParts);
+#else
+    const QVector<QStringRef> lineList = lines.splitRef('\n', Qt::SkipEmptyParts);
+#endif
+    for (const QStringRef &line : lineList) {
+        if (!prompt.isEmpty() && line.contains(prompt)) {
+            if (line.contains(keyRowCmd))
+                continue;
+            keyRowCmd.clear();
+            break;
+        }
+        QRegularExpressionMatch reMatch = keyRowPattern.match(line);
+        if (!reMatch.hasMatch())
+            continue;
+        QStringList cells = reMatch.captured().toUpper().remove(" ").split("|");
+        if (cells.size() <= qMax(keyRowAIndex, keyRowBIndex))
+            continue;
+        // the sector is the first cell, the rows are in order if it's missing
+        int sectorId = -1;
+        for (const QString &cell : qAsConst(cells)) {
+            if (!cell.isEmpty()) {
+                bool isNumber = false;
+                sectorId = cell.toInt(&isNumber);
+                if (!isNumber)
+                    sectorId = keyRowCount;
+                break;
             }
         }
+        keyRowCount++;
+        if (sectorId < 0 || sectorId >= cardType.sector_size)
+            continue;
+        const KeyType keyTypes[2] = {KEY_A, KEY_B};
+        const int keyIndex[2] = {keyRowAIndex, keyRowBIndex};
+        for (int i = 0; i < 2; i++) {
+            if (!data_isKeyValid(cells[keyIndex[i]]))
+                continue;
+            image->setKeyText(sectorId, keyTypes[i], cells[keyIndex[i]]);
+            data_syncWithKeyWidget(false, sectorId, keyTypes[i]);
+            storeKey(sectorId, keyTypes[i]);
+            storedCount++;
+        }
     }
+    if (storedCount > 0)
+        keyStore->save();
+}
 
-    data_syncWithKeyWidget();
+int Mifare::data_keyRowCount() {
+    // the rows parsed from the running command
+    return keyRowCmd.isEmpty() ? 0 : keyRowCount;
 }
 
 void Mifare::nested(bool isStaticNested) {
+    if (!isStaticNested && useStoredKeys())
+        return;
     // === ✨ 新增：强制前置检查 (是否扫描过默认密码) ===
     if (!isStaticNested) {
         bool hasKnownKey = false;
         for (int i = 0; i < cardType.sector_size; i++) {
-            if (data_isKeyValid(keyAList->at(i)) || data_isKeyValid(keyBList->at(i))) {
+            if (image->key(i, KEY_A).isKnown() || image->key(i, KEY_B).isKnown()) {
                 hasKnownKey = true;
                 break;
             }
@@ -193,23 +246,19 @@ void Mifare::nested(bool isStaticNested) {
     QVariantMap config = configMap["nested"].toMap();
     QString cmd = isStaticNested ? config["static cmd"].toString() : config["cmd"].toString();
 
-    int keyAindex = config["key A index"].toInt();
-    int keyBindex = config["key B index"].toInt();
-    QRegularExpression keyPattern = QRegularExpression(config["key pattern"].toString(), QRegularExpression::MultilineOption);
-
     // --- 1. 智能寻找：找一个已知的密码作为默认“已知密钥” ---
     QString defaultKey = "FFFFFFFFFFFF";
     int defaultSector = 0;
     QString defaultType = "A";
 
     for (int i = 0; i < cardType.sector_size; i++) {
-        if (data_isKeyValid(keyAList->at(i))) {
-            defaultKey = keyAList->at(i);
+        if (image->key(i, KEY_A).isKnown()) {
+            defaultKey = image->keyText(i, KEY_A);
             defaultSector = i;
             defaultType = "A";
             break;
-        } else if (data_isKeyValid(keyBList->at(i))) {
-            defaultKey = keyBList->at(i);
+        } else if (image->key(i, KEY_B).isKnown()) {
+            defaultKey = image->keyText(i, KEY_B);
             defaultSector = i;
             defaultType = "B";
             break;
@@ -297,6 +346,8 @@ void Mifare::nested(bool isStaticNested) {
 
     Util::gotoRawTab(); // <--- 新增：在开始发命令前切到控制台
 
+    // the keys are filled by data_parseKeyRows() while nested is running
+    startKeyRows("nested", cmd);
     QString result = util->execCMDWithOutput(
         cmd,
         Util::ReturnTrigger(15000, {"Quit", "Can't found", "Can't authenticate", keyPattern_res->pattern()}),
@@ -307,27 +358,15 @@ void Mifare::nested(bool isStaticNested) {
         nested(true);
         return;
     }
-
-    // 解析结果并更新到 UI 面板
-    int offset = 0;
-    for (int i = 0; i < cardType.sector_size; i++) {
-        QRegularExpressionMatch reMatch = keyPattern.match(result, offset);
-        if (reMatch.hasMatch()) {
-            QString data = reMatch.captured().toUpper();
-            offset = reMatch.capturedStart() + data.length();
-            QStringList cells = data.remove(" ").split("|");
-            if (!cells[keyAindex].contains(QRegularExpression("[^0-9a-fA-F]"))) keyAList->replace(i, cells[keyAindex]);
-            if (!cells[keyBindex].contains(QRegularExpression("[^0-9a-fA-F]"))) keyBList->replace(i, cells[keyBindex]);
-        }
-    }
-    data_syncWithKeyWidget();
 }
 
 void Mifare::hardnested() {
+    if (useStoredKeys())
+        return;
     // === ✨ 新增：强制前置检查 ===
     bool hasKnownKey = false;
     for (int i = 0; i < cardType.sector_size; i++) {
-        if (data_isKeyValid(keyAList->at(i)) || data_isKeyValid(keyBList->at(i))) {
+        if (image->key(i, KEY_A).isKnown() || image->key(i, KEY_B).isKnown()) {
             hasKnownKey = true;
             break;
         }
@@ -349,13 +388,13 @@ void Mifare::hardnested() {
     QString defaultKnownType = "A";
 
     for (int i = 0; i < cardType.sector_size; i++) {
-        if (data_isKeyValid(keyAList->at(i))) {
-            defaultKnownKey = keyAList->at(i);
+        if (image->key(i, KEY_A).isKnown()) {
+            defaultKnownKey = image->keyText(i, KEY_A);
             defaultKnownSector = i;
             defaultKnownType = "A";
             break;
-        } else if (data_isKeyValid(keyBList->at(i))) {
-            defaultKnownKey = keyBList->at(i);
+        } else if (image->key(i, KEY_B).isKnown()) {
+            defaultKnownKey = image->keyText(i, KEY_B);
             defaultKnownSector = i;
             defaultKnownType = "B";
             break;
@@ -366,7 +405,7 @@ void Mifare::hardnested() {
     int defaultTargetSector = 0;
     for (int i = 0; i < cardType.sector_size; i++) {
         // 如果 A 密码或 B 密码有任意一个是无效的，说明这个扇区需要破解
-        if (!data_isKeyValid(keyAList->at(i)) || !data_isKeyValid(keyBList->at(i))) {
+        if (!image->key(i, KEY_A).isKnown() || !image->key(i, KEY_B).isKnown()) {
             defaultTargetSector = i;
             break;
         }
@@ -418,6 +457,13 @@ void Mifare::hardnested() {
 
     form.addRow(new QLabel(tr(" "))); // 空行分隔
 
+    // the nonces can be archived and solved by the offline client, so the
+    // reader is free again as soon as they are collected
+    QCheckBox *offlineBox = new QCheckBox(tr("Archive the nonces and solve them offline"), &dialog);
+    offlineBox->setToolTip(tr("The nonce files are kept per card, so the retries don't need the card"));
+    offlineBox->setEnabled(!currUID.isEmpty() && !config["offline cmd"].toString().isEmpty());
+    form.addRow(offlineBox);
+
     // 同样，把底部的 ButtonBox 替换成稳健的写法：
     QDialogButtonBox *buttonBox = new QDialogButtonBox(Qt::Horizontal, &dialog);
     QPushButton *okBtn = new QPushButton(tr("确定 (OK)"));
@@ -452,6 +498,36 @@ void Mifare::hardnested() {
         cmd.replace("<target key block>", QString::number(finalTargetBlock));
         cmd.replace("<target key type>", config["target key type"].toMap()[finalTargetType].toString());
 
+        // the key is reported later by MainWindow::refreshOutput()
+        hardnestedSector = targetSectorCombo->currentIndex();
+        hardnestedKeyType = finalTargetType == "B" ? KEY_B : KEY_A;
+
+        if (offlineBox->isChecked()) {
+            QString file = nonceFile(currUID, hardnestedSector, hardnestedKeyType);
+            if (QFile::exists(file)) {
+                // archived by a previous attempt, the card is not needed
+                emit noncesCollected(currUID, hardnestedSector, (char)hardnestedKeyType, file, false);
+                hardnestedSector = -1;
+                return;
+            }
+            QDir().mkpath(QFileInfo(file).absolutePath());
+            cmd += config["nonce file"].toString().replace("<file>", QDir::toNativeSeparators(file));
+            Util::gotoRawTab();
+            // the collecting prints its progress, so the wait time is only
+            // the idle timeout
+            QString result = util->execCMDWithOutput(
+                cmd, Util::ReturnTrigger(30000, {config["collected flag"].toString()}));
+            if (result.isEmpty()) {
+                // failed, or the key is found before the brute force phase,
+                // the partial file is useless either way
+                QFile::remove(file);
+                return;
+            }
+            emit noncesCollected(currUID, hardnestedSector, (char)hardnestedKeyType, file, true);
+            hardnestedSector = -1;
+            return;
+        }
+
         // 发送给客户端并跳转到控制台
         util->execCMD(cmd);
         Util::gotoRawTab();
@@ -528,8 +604,9 @@ QString Mifare::_readblk(int blockId, KeyType keyType, const QString &key,
 
         currMatch = dataPattern.match(result);
         if (currMatch.hasMatch()) {
-            data = currMatch.captured().toUpper();
-            data.remove(" ");
+            data = _matchedBlock(currMatch.capturedRef());
+            if (isTrailerBlock)
+                setKnownACBits(data_b2s(blockId), data);
             // when the target block is a key block and the given key type is KeyA,
             // try to check whether the KeyB is valid(by Access Bits) if the given key
             // type is KeyB, it will never get the KeyA from the key block
@@ -561,8 +638,7 @@ QString Mifare::_readblk(int blockId, KeyType keyType, const QString &key,
         result = util->execCMDWithOutput(cmd, waitTime);
         currMatch = dataPattern.match(result);
         if (currMatch.hasMatch()) {
-            data = currMatch.captured().toUpper();
-            data.remove(" ");
+            data = _matchedBlock(currMatch.capturedRef());
         } else
             data = "";
     } else if (targetType == TARGET_EMULATOR) {
@@ -572,8 +648,8 @@ QString Mifare::_readblk(int blockId, KeyType keyType, const QString &key,
             QRegularExpression(config["data pattern"].toString());
         cmd.replace("<block>", QString::number(blockId));
         result = util->execCMDWithOutput(cmd, 150);
-        data = dataPattern.match(result).captured().toUpper();
-        data.remove(" ");
+        currMatch = dataPattern.match(result);
+        data = _matchedBlock(currMatch.capturedRef());
     }
 
     return data;
@@ -583,9 +659,7 @@ QStringList Mifare::_readsec(int sectorId, KeyType keyType, const QString &key,
                              TargetType targetType, int waitTime) {
     QVariantMap config;
     QStringList data;
-    QString result, tmp;
-    QRegularExpressionMatch reMatch;
-    int offset = -1; // for targetType == TARGET_EMULATOR
+    QString result;
 
     for (int i = 0; i < cardType.blk[sectorId]; i++) {
         data.append("");
@@ -617,6 +691,286 @@ QStringList Mifare::_readsec(int sectorId, KeyType keyType, const QString &key,
 
     // for TARGET_MIFARE and TARGET_UID
     // if targetType == TARGET_EMULATOR, this function has returned
+    data = _parsesec(sectorId, keyType, key, targetType, result);
+    // when one of the block cannot be read, the rdsc will return nothing, so you
+    // need to read the rest of blocks manually the following rdbl operation is
+    // not handled there, for better speed(rdsc_A->rdsc_B->rdbl0~3)
+    if (data[0] == "" && targetType == TARGET_UID) // treat as MIFARE
+        data = _readsec(sectorId, keyType, key, TARGET_MIFARE, waitTime);
+
+    return data;
+}
+
+QMap<int, QStringList> Mifare::_readsecs(const QMap<int, KeyType> &plan,
+                                         int waitTime) {
+    // read several sectors of a MIFARE card with one batch of rdsc commands,
+    // so only the last response waits for the client.
+    // plan: {sector id, the key type used to read it}
+    QMap<int, QStringList> data;
+    QStringList cmds;
+    QList<int> sentIds;
+    QVariantMap config = configMap["normal read sector"].toMap();
+
+    for (auto it = plan.cbegin(); it != plan.cend(); ++it) {
+        int sectorId = it.key();
+        KeyType keyType = it.value();
+        QStringList empty;
+        for (int i = 0; i < cardType.blk[sectorId]; i++)
+            empty.append("");
+        data[sectorId] = empty;
+        if (!image->key(sectorId, keyType).isKnown())
+            continue;
+        QString cmd = config["cmd"].toString();
+        cmd.replace("<sector>", QString::number(sectorId));
+        cmd.replace("<key type>",
+                    config["key type"].toMap()[QString((char)keyType)].toString());
+        cmd.replace("<key>", image->keyText(sectorId, keyType));
+        cmds.append(cmd);
+        sentIds.append(sectorId);
+    }
+    if (cmds.isEmpty())
+        return data;
+
+    QStringList results = util->execCMDsWithOutput(cmds, waitTime);
+    for (int i = 0; i < sentIds.size(); i++) {
+        KeyType keyType = plan[sentIds[i]];
+        data[sentIds[i]] =
+            _parsesec(sentIds[i], keyType, image->keyText(sentIds[i], keyType),
+                      TARGET_MIFARE, results[i]);
+    }
+    return data;
+}
+
+void Mifare::resetReadCache() {
+    readCache.fill(SectorReadCache());
+    readCache.resize(cardType.sector_size);
+}
+
+void Mifare::_checkUID() {
+    // the card might have been swapped without info(), then the Access Bits
+    // and the failed keys in readCache belong to the last card. info()
+    // resets the cache if the UID has changed.
+    info(true);
+}
+
+Mifare::ReadResult Mifare::getCachedRead(int sectorId, KeyType keyType) {
+    int k = (keyType == KEY_A) ? 0 : 1;
+    const SectorReadCache &cache = readCache[sectorId];
+    // the result is about another key
+    if (cache.key[k] != image->key(sectorId, keyType))
+        return READ_UNTRIED;
+    return cache.result[k];
+}
+
+void Mifare::setCachedRead(int sectorId, KeyType keyType, ReadResult result) {
+    int k = (keyType == KEY_A) ? 0 : 1;
+    readCache[sectorId].key[k] = image->key(sectorId, keyType);
+    readCache[sectorId].result[k] = result;
+}
+
+QList<quint8> Mifare::getKnownACBits(int sectorId) {
+    // empty if the trailer hasn't been read from the card on the reader. The
+    // trailer in the data widget might come from a dump file or another card.
+    return readCache[sectorId].ACBits;
+}
+
+void Mifare::setKnownACBits(int sectorId, const QString &trailer) {
+    // trailer: read from(or written to) the card on the reader
+    QList<quint8> ACBits = data_getACBits(trailer.mid(12, 8));
+    if (!ACBits.isEmpty())
+        readCache[sectorId].ACBits = ACBits;
+}
+
+int Mifare::getACBitsIndex(int sectorId, int blockId) {
+    // the index in data_getACBits(), 3 for the trailer
+    int offset = blockId - cardType.blks[sectorId];
+    if (offset == cardType.blk[sectorId] - 1)
+        return 3;
+    // a 16-block sector shares one access condition among 5 blocks
+    return (cardType.blk[sectorId] == 4) ? offset : offset / 5;
+}
+
+bool Mifare::isReadableBy(int sectorId, int blockId, KeyType keyType) {
+    QList<quint8> ACBits = getKnownACBits(sectorId);
+    if (ACBits.isEmpty())
+        return true; // unknown, worth a try
+    AccessType keyAccess = (keyType == KEY_A) ? ACC_KEY_A : ACC_KEY_B;
+    int index = getACBitsIndex(sectorId, blockId);
+    if (index == 3) // the Access Bits are always read with the trailer
+        return trailerReadCondition[ACBits[3]][1] & keyAccess;
+    return dataCondition[ACBits[index]][0] & keyAccess;
+}
+
+bool Mifare::isWritableBy(int sectorId, int blockId, KeyType keyType) {
+    QList<quint8> ACBits = getKnownACBits(sectorId);
+    if (ACBits.isEmpty())
+        return true; // unknown, worth a try
+    AccessType keyAccess = (keyType == KEY_A) ? ACC_KEY_A : ACC_KEY_B;
+    int index = getACBitsIndex(sectorId, blockId);
+    if (index == 3) {
+        // any writable part of the trailer makes the write succeed
+        for (int i = 0; i < 3; i++) {
+            if (trailerWriteCondition[ACBits[3]][i] & keyAccess)
+                return true;
+        }
+        return false;
+    }
+    return dataCondition[ACBits[index]][1] & keyAccess;
+}
+
+QList<Mifare::KeyType> Mifare::_planSectorRead(int sectorId) {
+    // the keys worth an rdsc, in order
+    QList<KeyType> plan;
+    for (KeyType keyType : {KEY_A, KEY_B}) {
+        if (!image->key(sectorId, keyType).isKnown() ||
+            getCachedRead(sectorId, keyType) == READ_FAILED)
+            continue;
+        // rdsc fails if any block of the sector cannot be read
+        bool isSectorReadable = true;
+        for (int i = 0; i < cardType.blk[sectorId] && isSectorReadable; i++)
+            isSectorReadable = isReadableBy(sectorId, cardType.blks[sectorId] + i, keyType);
+        if (isSectorReadable)
+            plan.append(keyType);
+    }
+    if (plan.size() == 2 && getCachedRead(sectorId, KEY_B) == READ_OK &&
+        getCachedRead(sectorId, KEY_A) != READ_OK)
+        plan = {KEY_B, KEY_A};
+    return plan;
+}
+
+void Mifare::_fillTrailerKeys(int sectorId, QString &trailer) {
+    // the keys which have read this sector are known to be right
+    if (trailer.length() != 32)
+        return;
+    if (trailer.left(12) == "????????????" && getCachedRead(sectorId, KEY_A) == READ_OK)
+        trailer.replace(0, 12, image->keyText(sectorId, KEY_A));
+    if (trailer.right(12) == "????????????" && getCachedRead(sectorId, KEY_B) == READ_OK)
+        trailer.replace(20, 12, image->keyText(sectorId, KEY_B));
+}
+
+QMap<int, QStringList> Mifare::_readPlanned(const QList<int> &sectorIds,
+                                            const QList<int> &selectedBlocks,
+                                            bool isReadingBlocks) {
+    // read the sectors of a MIFARE card with as few commands as possible:
+    // 1. rdsc with the first planned key of every sector, in one batch, then
+    //    with the next planned key for the sectors which failed
+    // 2. rdsc with KeyB for the trailers whose KeyB part is still unknown
+    // 3. rdbl for the rest of the selected blocks, with the keys the Access
+    //    Bits allow(if isReadingBlocks is true)
+    // The sectors not read yet are left empty if the reading is cancelled.
+    Util::CancelToken token = util->cancelToken();
+    _checkUID();
+    QMap<int, QStringList> data;
+    QMap<int, QList<KeyType>> plan;
+    for (int sectorId : sectorIds) {
+        QStringList empty;
+        for (int i = 0; i < cardType.blk[sectorId]; i++)
+            empty.append("");
+        data[sectorId] = empty;
+        plan[sectorId] = _planSectorRead(sectorId);
+    }
+
+    while (!util->isCancelled(token)) {
+        QMap<int, KeyType> batch;
+        for (auto it = plan.begin(); it != plan.end(); ++it) {
+            if (!it.value().isEmpty())
+                batch[it.key()] = it.value().takeFirst();
+        }
+        if (batch.isEmpty())
+            break;
+        QMap<int, QStringList> result = _readsecs(batch);
+        bool isAnyRead = false;
+        for (auto it = result.cbegin(); it != result.cend(); ++it) {
+            if (it.value()[0] != "")
+                isAnyRead = true;
+        }
+        for (auto it = result.cbegin(); it != result.cend(); ++it) {
+            if (it.value()[0] != "") {
+                setCachedRead(it.key(), batch[it.key()], READ_OK);
+                data[it.key()] = it.value();
+                plan[it.key()].clear();
+            } else if (isAnyRead) // if nothing is read, the card is probably gone
+                setCachedRead(it.key(), batch[it.key()], READ_FAILED);
+        }
+    }
+
+    QMap<int, KeyType> trailerBatch;
+    for (int sectorId : sectorIds) {
+        QString &trailer = data[sectorId][cardType.blk[sectorId] - 1];
+        _fillTrailerKeys(sectorId, trailer);
+        if (trailer.right(12) == "????????????" && !util->isCancelled(token) &&
+            selectedBlocks.contains(getTrailerBlockId(sectorId)) &&
+            image->key(sectorId, KEY_B).isKnown() &&
+            getCachedRead(sectorId, KEY_B) == READ_UNTRIED &&
+            isReadableBy(sectorId, getTrailerBlockId(sectorId), KEY_B))
+            trailerBatch[sectorId] = KEY_B;
+    }
+    QMap<int, QStringList> trailerResult = _readsecs(trailerBatch);
+    for (auto it = trailerResult.cbegin(); it != trailerResult.cend(); ++it) {
+        QStringList &sector = data[it.key()];
+        if (it.value()[0] == "") {
+            setCachedRead(it.key(), KEY_B, READ_FAILED);
+            continue;
+        }
+        setCachedRead(it.key(), KEY_B, READ_OK);
+        _fillTrailerKeys(it.key(), sector.last());
+    }
+
+    if (!isReadingBlocks)
+        return data;
+
+    for (int sectorId : sectorIds) {
+        if (util->isCancelled(token))
+            break;
+        QStringList &sector = data[sectorId];
+        for (int i = 0; i < cardType.blk[sectorId]; i++) {
+            int blockId = cardType.blks[sectorId] + i;
+            if (sector[i] != "" || !selectedBlocks.contains(blockId))
+                continue;
+            for (KeyType keyType : {KEY_A, KEY_B}) {
+                if (!image->key(sectorId, keyType).isKnown() ||
+                    !isReadableBy(sectorId, blockId, keyType))
+                    continue;
+                sector[i] = _readblk(blockId, keyType, image->keyText(sectorId, keyType));
+                if (sector[i] != "")
+                    break;
+            }
+        }
+        _fillTrailerKeys(sectorId, sector.last());
+    }
+    return data;
+}
+
+QString Mifare::_matchedBlock(const QStringRef &text) {
+    // the block in the form of the data widget(32 upper case digits), copied
+    // once from the output, "" if it isn't a block
+    QString result;
+    result.reserve(32);
+    for (const QChar &ch : text) {
+        if (ch == ' ')
+            continue;
+        if (result.length() == 32)
+            return "";
+        result.append(ch.toUpper());
+    }
+    return (result.length() == 32) ? result : "";
+}
+
+QStringList Mifare::_parsesec(int sectorId, KeyType keyType, const QString &key,
+                              TargetType targetType, const QString &result) {
+    QVariantMap config;
+    QStringList data;
+    QRegularExpressionMatch reMatch;
+    int offset = -1;
+
+    for (int i = 0; i < cardType.blk[sectorId]; i++) {
+        data.append("");
+    }
+    if (targetType == TARGET_MIFARE)
+        config = configMap["normal read sector"].toMap();
+    else if (targetType == TARGET_UID)
+        config = configMap["Magic Card read sector"].toMap();
+
     QRegularExpression dataPattern =
         QRegularExpression(config["data pattern"].toString());
     reMatch = dataPattern.match(result);
@@ -627,22 +981,16 @@ QStringList Mifare::_readsec(int sectorId, KeyType keyType, const QString &key,
             reMatch = dataPattern.match(result, offset);
             offset = reMatch.capturedStart();
             if (reMatch.hasMatch()) {
-                tmp = reMatch.captured().toUpper();
-                offset += tmp.length();
-                tmp.remove(" ");
-                data[i] = tmp;
+                offset = reMatch.capturedEnd();
+                data[i] = _matchedBlock(reMatch.capturedRef());
             }
         }
     }
-    // when one of the block cannot be read, the rdsc will return nothing, so you
-    // need to read the rest of blocks manually the following rdbl operation is
-    // not handled there, for better speed(rdsc_A->rdsc_B->rdbl0~3)
-    else if (targetType == TARGET_UID) // treat as MIFARE
-        data = _readsec(sectorId, keyType, key, TARGET_MIFARE, waitTime);
 
     // process trailer(like _readblk())
     QString trailer = data[cardType.blk[sectorId] - 1];
     if (trailer != "" && targetType == TARGET_MIFARE) {
+        setKnownACBits(sectorId, trailer);
         if (keyType == KEY_A) // in this case, the Access Bits is always accessible
         {
             trailer.replace(0, 12, key);
@@ -689,7 +1037,6 @@ void Mifare::readOne(TargetType targetType) {
 }
 
 void Mifare::readSelected(TargetType targetType) {
-    QString trailerA, trailerB;
     QList<bool> selectedSectors;
     QList<int> selectedBlocks;
     for (int i = 0; i < cardType.block_size; i++) {
@@ -709,7 +1056,7 @@ void Mifare::readSelected(TargetType targetType) {
         for (int i = 0; i < cardType.sector_size; i++) {
             if (selectedSectors[i]) {
                 // 如果选中的扇区，其 A 密码和 B 密码都无效，说明该扇区必定无法读取
-                if (!data_isKeyValid(keyAList->at(i)) && !data_isKeyValid(keyBList->at(i))) {
+                if (!image->key(i, KEY_A).isKnown() && !image->key(i, KEY_B).isKnown()) {
                     missingKeySectors++;
                 }
             }
@@ -740,74 +1087,50 @@ void Mifare::readSelected(TargetType targetType) {
         }
     }
     // ==========================================
-    for (int i = 0; i < cardType.sector_size; i++) {
-        if (!selectedSectors[i])
-            continue;
 
-        QStringList data, dataA, dataB;
-        for (int j = 0; j < cardType.blk[i]; j++) {
-            // dataA is always filled with "" because of the _readsec()
-            data.append("");
-            dataB.append("");
+    Util::CancelToken token = util->cancelToken();
+    // for MIFARE cards, the read planner decides which key reads which sector
+    QMap<int, QStringList> plannedData;
+    if (targetType == TARGET_MIFARE) {
+        QList<int> sectorIds;
+        for (int i = 0; i < cardType.sector_size; i++) {
+            if (selectedSectors[i])
+                sectorIds.append(i);
         }
+        plannedData = _readPlanned(sectorIds, selectedBlocks);
+    }
 
-        dataA = _readsec(i, Mifare::KEY_A, keyAList->at(i), targetType);
-
-        // in other situations, the key doesn't matters
-        // so the dataA is the final result
-        //
-        // if the targetType is TARGET_MIFARE and the dataA has unknown part, try to
-        // read by keyB
-        if (targetType == TARGET_MIFARE &&
-            (dataA.contains("") ||
-             dataA[cardType.blk[i] - 1].right(12) == "????????????"))
-            dataB = _readsec(i, Mifare::KEY_B, keyBList->at(i), targetType);
-
-        // process trailer block seperately
-        if (dataA[cardType.blk[i] - 1] == "" &&
-            selectedBlocks.contains(getTrailerBlockId(i)))
-            dataA[cardType.blk[i] - 1] = _readblk(getTrailerBlockId(i), Mifare::KEY_A,
-                                                  keyAList->at(i), targetType);
-        if (dataB[cardType.blk[i] - 1] == "" &&
-            dataA[cardType.blk[i] - 1].right(12) == "????????????" &&
-            selectedBlocks.contains(getTrailerBlockId(i)))
-            dataB[cardType.blk[i] - 1] = _readblk(getTrailerBlockId(i), Mifare::KEY_B,
-                                                  keyBList->at(i), targetType);
-
-        for (int j = 0; j < cardType.blk[i]; j++) {
-            if (dataA[j] != "")
-                data[j] = dataA[j];
-            else
-                data[j] = dataB[j];
+    for (int i = 0; i < cardType.sector_size; i++) {
+        if (!selectedSectors[i])
+            continue;
 
-            if (data[j] == "" &&
-                selectedBlocks.contains(cardType.blks[i] + j)) // try rdbl seperately
-            {
-                data[j] = _readblk(cardType.blks[i] + j, Mifare::KEY_A, keyAList->at(i),
-                                   targetType);
-                if (data[j] == "")
-                    data[j] = _readblk(cardType.blks[i] + j, Mifare::KEY_B,
-                                       keyBList->at(i), targetType);
+        QStringList data;
+        if (targetType == TARGET_MIFARE) {
+            data = plannedData[i];
+            // keep the old data of the sectors the cancelled reading didn't reach
+            if (util->isCancelled(token) && data.join("").isEmpty())
+                continue;
+        } else {
+            if (util->isCancelled(token))
+                break;
+            // in other situations, the key doesn't matters
+            data = _readsec(i, Mifare::KEY_A, image->keyText(i, KEY_A), targetType);
+            for (int j = 0; j < cardType.blk[i]; j++) {
+                if (data[j] == "" &&
+                    selectedBlocks.contains(cardType.blks[i] + j)) // try rdbl seperately
+                {
+                    data[j] = _readblk(cardType.blks[i] + j, Mifare::KEY_A,
+                                       image->keyText(i, KEY_A), targetType);
+                    if (data[j] == "")
+                        data[j] = _readblk(cardType.blks[i] + j, Mifare::KEY_B,
+                                           image->keyText(i, KEY_B), targetType);
+                }
             }
         }
 
-        // process trailer block seperately
-        trailerA = dataA[cardType.blk[i] - 1];
-        trailerB = dataB[cardType.blk[i] - 1];
-        if (trailerA != "" &&
-            trailerB !=
-                "") // if KeyA and KeyB can both read the trailer, then concat them
-        {
-            QString ACbits = trailerA.mid(12, 8);
-            QString key_A = trailerA.left(12); // KeyA cannot be read by KeyB
-            QString key_B =
-                trailerA.at(31) != '?' ? trailerA.right(12) : trailerB.right(12);
-            data[cardType.blk[i] - 1] = key_A + ACbits + key_B;
-        }
-
         for (int j = 0; j < cardType.blk[i]; j++) {
             if (selectedBlocks.contains(cardType.blks[i] + j)) {
-                dataList->replace(cardType.blks[i] + j, data[j]);
+                image->setBlockText(cardType.blks[i] + j, data[j]);
                 data_syncWithDataWidget(false, cardType.blks[i] + j);
             }
         }
@@ -818,10 +1141,10 @@ void Mifare::readSelected(TargetType targetType) {
                 data[cardType.blk[i] - 1] = "????????????????????????????????";
 
             // doesn't replace the existing key.
-            if (!data_isKeyValid(keyAList->at(i)))
-                keyAList->replace(i, data[cardType.blk[i] - 1].left(12));
-            if (!data_isKeyValid(keyBList->at(i)))
-                keyBList->replace(i, data[cardType.blk[i] - 1].right(12));
+            if (!image->key(i, KEY_A).isKnown())
+                image->setKeyText(i, KEY_A, data[cardType.blk[i] - 1].left(12));
+            if (!image->key(i, KEY_B).isKnown())
+                image->setKeyText(i, KEY_B, data[cardType.blk[i] - 1].right(12));
             data_syncWithKeyWidget(false, i, KEY_A);
             data_syncWithKeyWidget(false, i, KEY_B);
         }
@@ -841,40 +1164,21 @@ bool Mifare::_writeblk(int blockId, KeyType keyType, const QString &key,
     if (targetType == TARGET_MIFARE) {
         if (!data_isKeyValid(key))
             return false;
-        QVariantMap config = configMap["normal write block"].toMap();
-        QString cmd = config["cmd"].toString();
-        cmd.replace("<block>", QString::number(blockId));
-        cmd.replace("<key type>",
-                    config["key type"].toMap()[QString((char)keyType)].toString());
-        cmd.replace("<key>", key);
-        cmd.replace("<data>", input);
-        result = util->execCMDWithOutput(cmd, waitTime);
-        if (result.isEmpty())
-            return false;
-
-        QVariantList failedFlag =
-            config["failed flag"].toJsonArray().toVariantList();
-        for (auto flag = failedFlag.begin(); flag != failedFlag.end(); flag++) {
-            if (result.contains(flag->toString()))
-                return false;
-        }
-        return true;
+        result = util->execCMDWithOutput(_writeblkCmd(blockId, keyType, key, input),
+                                         waitTime);
+        bool isSucceeded = _isWriteSucceeded(result, configMap["normal write block"].toMap());
+        // the new Access Bits apply to the later reads and writes
+        int sectorId = data_b2s(blockId);
+        if (isSucceeded && blockId == getTrailerBlockId(sectorId))
+            setKnownACBits(sectorId, input);
+        return isSucceeded;
     } else if (targetType == TARGET_UID) {
         QVariantMap config = configMap["Magic Card write block"].toMap();
         QString cmd = config["cmd"].toString();
         cmd.replace("<block>", QString::number(blockId));
         cmd.replace("<data>", input);
         result = util->execCMDWithOutput(cmd, waitTime);
-        if (result.isEmpty())
-            return false;
-
-        QVariantList failedFlag =
-            config["failed flag"].toJsonArray().toVariantList();
-        for (auto flag = failedFlag.begin(); flag != failedFlag.end(); flag++) {
-            if (result.contains(flag->toString()))
-                return false;
-        }
-        return true;
+        return _isWriteSucceeded(result, config);
     } else if (targetType == TARGET_EMULATOR) {
         QVariantMap config = configMap["emulator write block"].toMap();
         QString cmd = config["cmd"].toString();
@@ -888,6 +1192,158 @@ bool Mifare::_writeblk(int blockId, KeyType keyType, const QString &key,
     return false;
 }
 
+QString Mifare::_writeblkCmd(int blockId, KeyType keyType, const QString &key,
+                             const QString &data) {
+    QVariantMap config = configMap["normal write block"].toMap();
+    QString cmd = config["cmd"].toString();
+    cmd.replace("<block>", QString::number(blockId));
+    cmd.replace("<key type>",
+                config["key type"].toMap()[QString((char)keyType)].toString());
+    cmd.replace("<key>", key);
+    cmd.replace("<data>", data);
+    return cmd;
+}
+
+bool Mifare::_isWriteSucceeded(const QString &result, const QVariantMap &config) {
+    if (result.isEmpty())
+        return false;
+
+    QVariantList failedFlag = config["failed flag"].toJsonArray().toVariantList();
+    for (auto flag = failedFlag.begin(); flag != failedFlag.end(); flag++) {
+        if (result.contains(flag->toString()))
+            return false;
+    }
+    return true;
+}
+
+QList<Mifare::WriteKey> Mifare::_planBlockWrite(int blockId,
+                                                const WriteKey &lastWorked) {
+    // the keys to try, in order:
+    // 1. the key which has written the previous block of this sector
+    // 2. the keys in the key widget, the one the Access Bits allow first
+    // 3. the default keys(for blank cards)
+    QList<WriteKey> plan;
+    int sectorId = data_b2s(blockId);
+    auto add = [&plan](KeyType keyType, const QString &key) {
+        WriteKey writeKey(keyType, key);
+        if (data_isKeyValid(key) && !plan.contains(writeKey))
+            plan.append(writeKey);
+    };
+    add(lastWorked.first, lastWorked.second);
+    // for access bits like "80 f7 87", the block can only be written with keyB
+    bool isKeyBFirst = !isWritableBy(sectorId, blockId, KEY_A) &&
+                       isWritableBy(sectorId, blockId, KEY_B);
+    KeyType first = isKeyBFirst ? KEY_B : KEY_A;
+    KeyType second = isKeyBFirst ? KEY_A : KEY_B;
+    add(first, image->keyText(sectorId, first));
+    add(second, image->keyText(sectorId, second));
+    add(first, "FFFFFFFFFFFF");
+    add(second, "FFFFFFFFFFFF");
+    return plan;
+}
+
+QList<int> Mifare::_writePlanned(const QList<int> &blockIds) {
+    // write the blocks of a MIFARE card sector by sector, returns the failed
+    // blocks. In each sector, the first planned key of every data block is
+    // sent in one batch, then the failed blocks try the rest of their keys.
+    // The trailer goes last because it may change the keys and the Access
+    // Bits.
+    // Once cancelled, the blocks not written yet are returned as failed.
+    Util::CancelToken token = util->cancelToken();
+    _checkUID();
+    QList<int> failedBlocks;
+    QVariantMap config = configMap["normal write block"].toMap();
+    QMap<int, QList<int>> sectors;
+    for (int blockId : blockIds)
+        sectors[data_b2s(blockId)].append(blockId);
+
+    for (auto it = sectors.cbegin(); it != sectors.cend(); ++it) {
+        if (util->isCancelled(token)) {
+            failedBlocks.append(it.value());
+            continue;
+        }
+        int sectorId = it.key();
+        int trailerId = getTrailerBlockId(sectorId);
+        WriteKey lastWorked(KEY_A, "");
+        QList<int> batchBlocks;
+        QList<QList<WriteKey>> plans;
+        QStringList cmds;
+        bool isTrailerSelected = false;
+
+        for (int blockId : it.value()) {
+            if (blockId == trailerId) {
+                isTrailerSelected = true;
+                continue;
+            }
+            QList<WriteKey> plan = _planBlockWrite(blockId, lastWorked);
+            if (plan.isEmpty() || data_isDataValid(image->blockText(blockId)) != DATA_NOSPACE) {
+                failedBlocks.append(blockId);
+                continue;
+            }
+            batchBlocks.append(blockId);
+            plans.append(plan);
+            cmds.append(_writeblkCmd(blockId, plan[0].first, plan[0].second,
+                                     image->blockText(blockId)));
+        }
+        QStringList results;
+        if (!cmds.isEmpty())
+            results = util->execCMDsWithOutput(cmds, 300);
+
+        for (int i = 0; i < batchBlocks.size(); i++) {
+            int blockId = batchBlocks[i];
+            if (_isWriteSucceeded(results.value(i), config)) {
+                lastWorked = plans[i][0];
+                continue;
+            }
+            // the block before has found a working key
+            QList<WriteKey> plan = plans[i];
+            if (lastWorked.second != "" && plan.indexOf(lastWorked) > 0)
+                plan.move(plan.indexOf(lastWorked), 1);
+            bool isWritten = false;
+            for (int j = 1; j < plan.size() && !isWritten && !util->isCancelled(token); j++) {
+                isWritten = _writeblk(blockId, plan[j].first, plan[j].second,
+                                      image->blockText(blockId), TARGET_MIFARE);
+                if (isWritten)
+                    lastWorked = plan[j];
+            }
+            if (!isWritten)
+                failedBlocks.append(blockId);
+        }
+
+        if (isTrailerSelected) {
+            bool isWritten = false;
+            for (const WriteKey &writeKey : _planBlockWrite(trailerId, lastWorked)) {
+                if (util->isCancelled(token))
+                    break;
+                isWritten = _writeblk(trailerId, writeKey.first, writeKey.second,
+                                      image->blockText(trailerId), TARGET_MIFARE);
+                if (isWritten)
+                    break;
+            }
+            if (!isWritten)
+                failedBlocks.append(trailerId);
+        }
+    }
+    std::sort(failedBlocks.begin(), failedBlocks.end());
+    return failedBlocks;
+}
+
+QStringList Mifare::readAll() {
+    // read every block of a MIFARE card with the current keys, like
+    // readSelected(), but the data widget is not touched.
+    QStringList result;
+    QList<int> sectorIds, blockIds;
+    for (int i = 0; i < cardType.sector_size; i++)
+        sectorIds.append(i);
+    for (int i = 0; i < cardType.block_size; i++)
+        blockIds.append(i);
+    // no rdbl fallback, a sector which cannot be read by rdsc is left empty
+    QMap<int, QStringList> data = _readPlanned(sectorIds, blockIds, false);
+    for (int i = 0; i < cardType.sector_size; i++)
+        result.append(data[i]);
+    return result;
+}
+
 void Mifare::writeOne(TargetType targetType) {
     int blockId = ui->MF_RW_blockBox->currentText().toInt();
     Mifare::KeyType keyType =
@@ -918,7 +1374,7 @@ void Mifare::writeSelected(TargetType targetType) {
     QList<int> validBlocks; // 暂存有效块
 
     for (int item : selectedBlocks) {
-        QString blockData = dataList->at(item);
+        QString blockData = image->blockText(item);
         blockData.remove(" ");
         blockData = blockData.toUpper();
 
@@ -960,12 +1416,12 @@ void Mifare::writeSelected(TargetType targetType) {
     }
     Util::gotoRawTab(); // <--- 新增：拦截器通过后，立刻切到控制台
     // =======================================================
+    QList<int> writeBlocks; // selectedBlocks without the skipped ones
     for (int item : selectedBlocks) {
-        bool result = false;
         bool isTrailerBlock =
             (item < 128 && ((item + 1) % 4 == 0)) || ((item + 1) % 16 == 0);
 
-        if (isTrailerBlock && !data_isACBitsValid(dataList->at(item).mid(12, 8))) // trailer block is invalid
+        if (isTrailerBlock && !data_isACBitsValid(image->blockText(item).mid(12, 8))) // trailer block is invalid
         {
             if (!yes2All && !no2All) {
                 QMessageBox msgBox(parent);
@@ -1001,32 +1457,20 @@ void Mifare::writeSelected(TargetType targetType) {
             }
         }
 
-        if (targetType == TARGET_MIFARE) {
-            result = _writeblk(item, KEY_A, keyAList->at(data_b2s(item)),
-                               dataList->at(item), TARGET_MIFARE);
-            if (!result) {
-                result = _writeblk(item, KEY_B, keyBList->at(data_b2s(item)),
-                                   dataList->at(item), TARGET_MIFARE);
-            }
-            if (!result && keyAList->at(data_b2s(item)) != "FFFFFFFFFFFF") {
-                result = _writeblk(item, KEY_A, "FFFFFFFFFFFF", dataList->at(item),
-                                   TARGET_MIFARE);
-            }
-            if (!result && keyBList->at(data_b2s(item)) !=
-                               "FFFFFFFFFFFF") // for access bits like "80 f7 87", the
-            // block can only be written with keyB
-            {
-                result = _writeblk(item, KEY_B, "FFFFFFFFFFFF", dataList->at(item),
-                                   TARGET_MIFARE);
-            }
-        } else // key doesn't matter when writing to Chinese Magic Card and Emulator
+        writeBlocks.append(item);
+    }
+
+    if (targetType == TARGET_MIFARE) {
+        failedBlocks = _writePlanned(writeBlocks);
+    } else {
+        // key doesn't matter when writing to Chinese Magic Card and Emulator
         // Memory
-        {
-            result = _writeblk(item, KEY_A, "FFFFFFFFFFFF", dataList->at(item),
-                               targetType);
-        }
-        if (!result) {
-            failedBlocks.append(item);
+        Util::CancelToken token = util->cancelToken();
+        for (int item : writeBlocks) {
+            if (util->isCancelled(token) ||
+                !_writeblk(item, KEY_A, "FFFFFFFFFFFF", image->blockText(item),
+                           targetType))
+                failedBlocks.append(item);
         }
     }
     if (failedBlocks.size() == 0)
@@ -1067,7 +1511,69 @@ void Mifare::writeSelected(TargetType targetType) {
     }
 }
 
+QString Mifare::chkCmd(bool isForPool) {
+    QVariantMap config = configMap["check"].toMap();
+    QString cmd = config["cmd"].toString();
+    cmd.replace("<card type>",
+                config["card type"].toMap()[cardType.typeText].toString());
+    // the keys which have worked on our cards are tried first. The devices of
+    // the pool hold other cards than the main reader, so their dictionary
+    // isn't ranked for currUID, and has its own file.
+    QString dictionary = config["dictionary"].toString();
+    if (!dictionary.isEmpty()) {
+        QString path = isForPool ? writeChkDictionary("", "chk-pool.dic")
+                                 : writeChkDictionary(currUID, "chk-session.dic");
+        if (!path.isEmpty())
+            cmd += dictionary.replace("<file>", QDir::toNativeSeparators(path));
+    }
+    return cmd;
+}
+
+QString Mifare::writeChkDictionary(const QString &uid, const QString &fileName) {
+    // write the keys from the key store(and the default keys of the config) to
+    // a dictionary file next to the key store, returns the path or "" if there
+    // is no key. The keys of the card uid come first, unless uid is "".
+    QList<quint64> keys = keyStore->dictionary(HexCodec::decode(uid),
+                                               cardType.sector_size);
+    // with "--no-default", the file replaces the built-in keys of the client,
+    // those which haven't worked on our cards come after the ranked ones
+    for (const QVariant &item : configMap["check"].toMap()["default keys"].toList()) {
+        bool isOk = false;
+        quint64 key = item.toString().toULongLong(&isOk, 16);
+        if (isOk && !keys.contains(key))
+            keys.append(key);
+    }
+    if (keys.isEmpty() || keyStore->getPath().isEmpty())
+        return "";
+    QString path = QFileInfo(keyStore->getPath()).absolutePath() + "/" + fileName;
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return "";
+    QByteArray buff;
+    buff.reserve(keys.size() * 13);
+    quint8 bytes[6];
+    for (quint64 key : keys) {
+        KeyStore::keyToBytes(key, bytes);
+        buff.append(HexCodec::encode(bytes, 6).toLatin1());
+        buff.append('\n');
+    }
+    file.write(buff);
+    file.close();
+    return path;
+}
+
+Util::ReturnTrigger Mifare::chkTrigger() {
+    QVariantMap config = configMap["check"].toMap();
+    return Util::ReturnTrigger(1000 + cardType.sector_size * 200,
+                               {"No valid", config["key pattern"].toString()});
+}
+
 void Mifare::dump(const QString &keyFilename) {
+    util->execCMD(dumpCmd(keyFilename));
+    Util::gotoRawTab();
+}
+
+QString Mifare::dumpCmd(const QString &keyFilename) {
     QVariantMap config = configMap["dump"].toMap();
     QString cmd = config["cmd"].toString();
     if (cmd.contains("<card type>"))
@@ -1078,12 +1584,16 @@ void Mifare::dump(const QString &keyFilename) {
     if (!keyFilename.isEmpty()) {
         cmd += " -k \"" + keyFilename + "\"";
     }
+    return cmd;
+}
 
-    util->execCMD(cmd);
+void Mifare::restore(const QString &dumpFilename, const QString &keyFilename, bool isBlankCard, bool force) {
+    // 异步发送命令，并切到控制台
+    util->execCMD(restoreCmd(dumpFilename, keyFilename, isBlankCard, force));
     Util::gotoRawTab();
 }
 
-void Mifare::restore(const QString &dumpFilename, const QString &keyFilename, bool isBlankCard, bool force) {
+QString Mifare::restoreCmd(const QString &dumpFilename, const QString &keyFilename, bool isBlankCard, bool force) {
     QVariantMap config = configMap["restore"].toMap();
     QString cmd = config["cmd"].toString();
     if (cmd.contains("<card type>"))
@@ -1110,10 +1620,17 @@ void Mifare::restore(const QString &dumpFilename, const QString &keyFilename, bo
     }
 
     cmd = cmd.simplified();
+    return cmd;
+}
 
-    // 异步发送命令，并切到控制台
-    util->execCMD(cmd);
-    Util::gotoRawTab();
+QString Mifare::offlineHardnestedCmd(const QString &nonceFilename) {
+    QString cmd = configMap["hardnested"].toMap()["offline cmd"].toString();
+    cmd.replace("<file>", QDir::toNativeSeparators(nonceFilename));
+    return cmd;
+}
+
+QStringList Mifare::offlineHardnestedArgs() {
+    return configMap["hardnested"].toMap()["offline args"].toStringList();
 }
 
 void Mifare::wipeC() {
@@ -1161,7 +1678,7 @@ void Mifare::lockC() {
     QVariantList list = config["sequence"].toJsonArray().toVariantList();
 
     for (auto item = list.begin(); item != list.end(); item++) {
-        qDebug() << cmd + item->toString();
+        qCDebug(lcMifare) << cmd + item->toString();
         util->execCMD(cmd + item->toString());
     }
 
@@ -1206,83 +1723,56 @@ void Mifare::saveSniff(const QString &file) {
 
 void Mifare::data_syncWithDataWidget(bool syncAll, int block) {
     ui->MF_dataWidget->blockSignals(true);
-    QString tmp;
     if (syncAll) {
-        for (int i = 0; i < cardType.block_size; i++) {
-            tmp = "";
-            if (dataList->at(i) != "") {
-                tmp += dataList->at(i).midRef(0, 2);
-                for (int j = 1; j < 16; j++) {
-                    tmp += " ";
-                    tmp += dataList->at(i).midRef(j * 2, 2);
-                }
-            }
-            ui->MF_dataWidget->item(i, 2)->setText(tmp);
-        }
+        for (int i = 0; i < cardType.block_size; i++)
+            ui->MF_dataWidget->item(i, 2)->setText(data_blockWithSpace(i));
     } else {
-        tmp = "";
-        if (dataList->at(block) != "") {
-            tmp += dataList->at(block).midRef(0, 2);
-            for (int j = 1; j < 16; j++) {
-                tmp += " ";
-                tmp += dataList->at(block).midRef(j * 2, 2);
-            }
-        }
-        ui->MF_dataWidget->item(block, 2)->setText(tmp);
+        ui->MF_dataWidget->item(block, 2)->setText(data_blockWithSpace(block));
     }
     ui->MF_dataWidget->blockSignals(false);
 }
 
+QString Mifare::data_blockWithSpace(int block) {
+    const CardImage::Bytes &data = image->block(block);
+    QString result;
+    if (data.isEmpty())
+        return result;
+    result.reserve(47);
+    result += data.byteText(0);
+    for (int j = 1; j < 16; j++) {
+        result += ' ';
+        result += data.byteText(j);
+    }
+    return result;
+}
+
 void Mifare::data_syncWithKeyWidget(bool syncAll, int sector, KeyType keyType) {
     ui->MF_keyWidget->blockSignals(true);
     if (syncAll) {
         for (int i = 0; i < cardType.sector_size; i++) {
-            ui->MF_keyWidget->item(i, 1)->setText(keyAList->at(i));
-            ui->MF_keyWidget->item(i, 2)->setText(keyBList->at(i));
+            ui->MF_keyWidget->item(i, 1)->setText(image->keyText(i, KEY_A));
+            ui->MF_keyWidget->item(i, 2)->setText(image->keyText(i, KEY_B));
         }
     } else {
         if (keyType == KEY_A)
-            ui->MF_keyWidget->item(sector, 1)->setText(keyAList->at(sector));
+            ui->MF_keyWidget->item(sector, 1)->setText(image->keyText(sector, KEY_A));
         else
-            ui->MF_keyWidget->item(sector, 2)->setText(keyBList->at(sector));
+            ui->MF_keyWidget->item(sector, 2)->setText(image->keyText(sector, KEY_B));
     }
     ui->MF_keyWidget->blockSignals(false);
 }
 
 void Mifare::data_clearData(bool clearAll) {
-    if (clearAll) {
-        dataList->clear();
-    }
-
-    int delta = cardType.block_size - dataList->length();
-    if (delta >= 0) {
-        for (int i = 0; i < delta; i++)
-            dataList->append("");
-    } else if (delta < 0) {
-        for (int i = 0; i < -delta; i++)
-
-            dataList->removeLast();
-    }
+    if (clearAll)
+        image->clearData();
+    image->resize(cardType.block_size, cardType.sector_size);
 }
 
 void Mifare::data_clearKey(bool clearAll) {
-    if (clearAll) {
-        keyAList->clear();
-        keyBList->clear();
-    }
-
-    int delta = cardType.sector_size - keyAList->length();
-    if (delta >= 0) {
-        for (int i = 0; i < delta; i++) {
-            keyAList->append("");
-            keyBList->append("");
-        }
-    } else if (delta < 0) {
-        for (int i = 0; i < -delta; i++) {
-            keyAList->removeLast();
-            keyBList->removeLast();
-        }
-    }
+    if (clearAll)
+        image->clearKeys();
+    image->resize(cardType.block_size, cardType.sector_size);
+    resetReadCache();
 }
 
 bool Mifare::data_isKeyValid(const QString &key) {
@@ -1358,17 +1848,13 @@ bool Mifare::data_loadDataFile(const QString &filename) {
         if (isBin) {
             if (file.size() < cardType.block_size * 16)
                 return false;
-            for (int i = 0; i < cardType.block_size; i++) {
-                QString tmp = bin2text(buff, i, 16);
-                dataList->replace(i, tmp.toUpper());
-            }
+            for (int i = 0; i < cardType.block_size; i++)
+                image->block(i) = CardImage::Bytes::fromRaw(buff.constData() + i * 16, 16);
         } else {
             QString tmp = buff.left(cardType.block_size * 34);
             QStringList tmpList = tmp.split("\n");
-            for (int i = 0; i < cardType.block_size; i++) {
-                dataList->replace(i, tmpList[i].toUpper());
-                qDebug() << tmpList[i];
-            }
+            for (int i = 0; i < cardType.block_size && i < tmpList.size(); i++)
+                image->setBlockText(i, tmpList[i]);
         }
         file.close();
 
@@ -1377,23 +1863,15 @@ bool Mifare::data_loadDataFile(const QString &filename) {
             // 判断当前块是不是密码控制块 (Trailer Block)
             bool isTrailer = (i < 128 && ((i + 1) % 4 == 0)) || ((i + 1) % 16 == 0);
             if (isTrailer) {
-                QString fileData = dataList->at(i);
-                if (fileData.length() == 32) {
-                    bool changed = false;
+                CardImage::Bytes &fileData = image->block(i);
+                if (fileData.isKnown()) {
+                    static const char zeroKey[6] = {0, 0, 0, 0, 0, 0};
                     // 如果读出的 KeyB 全是0，说明原卡 KeyB 隐藏不可读，自动转为 FFFFFFFFFFFF
-                    if (fileData.right(12) == "000000000000") {
-                        fileData.replace(20, 12, "FFFFFFFFFFFF");
-                        changed = true;
-                    }
+                    if (memcmp(fileData.data + 10, zeroKey, 6) == 0)
+                        memset(fileData.data + 10, 0xFF, 6);
                     // 如果 KeyA 也是0，同理恢复
-                    if (fileData.left(12) == "000000000000") {
-                        fileData.replace(0, 12, "FFFFFFFFFFFF");
-                        changed = true;
-                    }
-                    // 将修正后的数据写回内存列表
-                    if (changed) {
-                        dataList->replace(i, fileData);
-                    }
+                    if (memcmp(fileData.data, zeroKey, 6) == 0)
+                        memset(fileData.data, 0xFF, 6);
                 }
             }
         }
@@ -1425,31 +1903,34 @@ bool Mifare::data_compareDataFile(const QString &filename) {
     QString detailsHtml = ""; // 用于暂存每一个数据块的详细对比结果
 
     // 遍历每一个块，生成详细对比视图
+    QStringList textList;
+    if (!isBin)
+        textList = QString(buff.left(cardType.block_size * 34)).split("\n");
     for (int i = 0; i < cardType.block_size; i++) {
-        QString fileData = "";
+        CardImage::Bytes fileBytes;
         if (isBin) {
             if (buff.size() >= (i + 1) * 16)
-                fileData = bin2text(buff, i, 16).toUpper();
+                fileBytes = CardImage::Bytes::fromRaw(buff.constData() + i * 16, 16);
         } else {
-            QString tmp = buff.left(cardType.block_size * 34);
-            QStringList tmpList = tmp.split("\n");
-            if (tmpList.size() > i)
-                fileData = tmpList[i].toUpper();
+            if (textList.size() > i)
+                fileBytes = CardImage::Bytes::fromText(textList[i], 16);
         }
 
-        QString panelData = dataList->at(i);
+        const CardImage::Bytes &panelBytes = image->block(i);
+        QString panelData = panelBytes.toText();
+        QString fileData = fileBytes.toText();
         if (fileData.isEmpty()) fileData = "读取失败/数据缺失";
 
-        bool isDiff = (fileData != panelData);
+        bool isDiff = fileBytes.isEmpty() || fileBytes != panelBytes;
 
         QString pStr = "";
         QString fStr = "";
 
         // 核心逻辑：逐字节对比，不一致的加上红底红字的高亮 span
-        if (fileData.length() == 32 && panelData.length() == 32) {
+        if (!fileBytes.isEmpty() && !panelBytes.isEmpty()) {
             for (int j = 0; j < 16; j++) {
-                QString pb = panelData.mid(j * 2, 2);
-                QString fb = fileData.mid(j * 2, 2);
+                QString pb = panelBytes.byteText(j);
+                QString fb = fileBytes.byteText(j);
 
                 if (pb == fb) {
                     pStr += pb + "&nbsp;";
@@ -1554,20 +2035,21 @@ bool Mifare::data_loadKeyFile(const QString &filename) {
             // 修复：适配 Proxmark3 最新 key.bin 格式（先存所有 KeyA，再存所有 KeyB）
             for (int i = 0; i < cardType.sector_size; i++) {
                 // 读取 KeyA (每次读取6字节，偏移量: i * 6)
-                QString keyA = bin2text(buff, i, 6);
+                if (buff.size() >= (i + 1) * 6)
+                    image->key(i, KEY_A) = CardImage::Bytes::fromRaw(buff.constData() + i * 6, 6);
                 // 读取 KeyB (每次读取6字节，偏移量: (卡片总扇区数 + i) * 6)
-                QString keyB = bin2text(buff, i + cardType.sector_size, 6);
-
-                keyAList->replace(i, keyA.toUpper());
-                keyBList->replace(i, keyB.toUpper());
+                int offsetB = (i + cardType.sector_size) * 6;
+                if (buff.size() >= offsetB + 6)
+                    image->key(i, KEY_B) = CardImage::Bytes::fromRaw(buff.constData() + offsetB, 6);
             }
         } else {
             // 如果加载的是 dump.bin 数据文件
             for (int i = 0; i < cardType.sector_size; i++) {
                 int blk = getTrailerBlockId(i);
-                QString tmp = bin2text(buff, blk, 16);
-                keyAList->replace(i, tmp.left(12).toUpper());
-                keyBList->replace(i, tmp.right(12).toUpper());
+                if (buff.size() < (blk + 1) * 16)
+                    break;
+                image->key(i, KEY_A) = CardImage::Bytes::fromRaw(buff.constData() + blk * 16, 6);
+                image->key(i, KEY_B) = CardImage::Bytes::fromRaw(buff.constData() + blk * 16 + 10, 6);
             }
         }
         file.close();
@@ -1578,43 +2060,15 @@ bool Mifare::data_loadKeyFile(const QString &filename) {
     }
 }
 
-QString Mifare::bin2text(const QByteArray &buff, int i, int length) {
-    QString ret = "";
-    char LByte, RByte;
-    char map[16] = {'0', '1', '2', '3', '4', '5', '6', '7',
-                    '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
-    for (int j = 0; j < length; j++) {
-        LByte = map[(unsigned char)buff[i * length + j] >> 4];
-        RByte = map[(unsigned char)buff[i * length + j] & 0xF];
-        ret += LByte;
-        ret += RByte;
-    }
-    qDebug() << ret;
-    return ret;
-}
-
 bool Mifare::data_saveDataFile(const QString &filename, bool isBin) {
     QFile file(filename, this);
     if (file.open(QIODevice::WriteOnly)) {
         QByteArray buff;
-        QChar tmp;
         if (isBin) {
-            for (int i = 0; i < cardType.block_size; i++) {
-                for (int j = 0; j < 16; j++) {
-                    unsigned char Byt[2] = {0x0, 0x0};
-                    for (int k = 0; k < 2; k++) {
-                        tmp = dataList->at(i).at(j * 2 + k).toUpper();
-                        if (tmp >= '0' && tmp <= '9')
-                            Byt[k] = tmp.toLatin1() - '0';
-                        else if (tmp >= 'A' && tmp <= 'F')
-                            Byt[k] = tmp.toLatin1() - 'A' + 10;
-                    }
-                    buff += (Byt[0] << 4) | Byt[1];
-                }
-            }
+            image->writeBlocks(buff);
         } else {
             for (int i = 0; i < cardType.block_size; i++) {
-                buff += dataList->at(i);
+                buff += image->blockText(i);
                 buff += "\n";
             }
         }
@@ -1630,39 +2084,9 @@ bool Mifare::data_saveKeyFile(const QString &filename, bool isBin) {
     QFile file(filename, this);
     if (file.open(QIODevice::WriteOnly)) {
         QByteArray buff;
-        QChar tmp;
         if (isBin) {
             // 修复：保存时也先集中写所有 KeyA，再集中写所有 KeyB，保证与 PM3 生态统一
-
-            // 第一步：写入所有扇区的 KeyA
-            for (int i = 0; i < cardType.sector_size; i++) {
-                for (int j = 0; j < 6; j++) {
-                    unsigned char Byt[2] = {0x0, 0x0};
-                    for (int k = 0; k < 2; k++) {
-                        tmp = keyAList->at(i).at(j * 2 + k).toUpper();
-                        if (tmp >= '0' && tmp <= '9')
-                            Byt[k] = tmp.toLatin1() - '0';
-                        else if (tmp >= 'A' && tmp <= 'F')
-                            Byt[k] = tmp.toLatin1() - 'A' + 10;
-                    }
-                    buff += (Byt[0] << 4) | Byt[1];
-                }
-            }
-
-            // 第二步：写入所有扇区的 KeyB
-            for (int i = 0; i < cardType.sector_size; i++) {
-                for (int j = 0; j < 6; j++) {
-                    unsigned char Byt[2] = {0x0, 0x0};
-                    for (int k = 0; k < 2; k++) {
-                        tmp = keyBList->at(i).at(j * 2 + k).toUpper();
-                        if (tmp >= '0' && tmp <= '9')
-                            Byt[k] = tmp.toLatin1() - '0';
-                        else if (tmp >= 'A' && tmp <= 'F')
-                            Byt[k] = tmp.toLatin1() - 'A' + 10;
-                    }
-                    buff += (Byt[0] << 4) | Byt[1];
-                }
-            }
+            image->writeKeys(buff);
         } else {
             // 文本格式保存逻辑保持不变
         }
@@ -1675,64 +2099,173 @@ bool Mifare::data_saveKeyFile(const QString &filename, bool isBin) {
 }
 
 void Mifare::data_key2Data() {
+    static const quint8 defaultAccess[4] = {0xFF, 0x07, 0x80, 0x69}; // default control bytes
     for (int i = 0; i < cardType.sector_size; i++) {
-        QString tmp = "";
-        if (data_isKeyValid(keyAList->at(i)))
-            tmp += keyAList->at(i);
-        else
-            tmp += "????????????";
-
-        if (dataList->at(getTrailerBlockId(i)) == "")
-            tmp += "FF078069"; // default control bytes
+        CardImage::Bytes &trailer = image->block(getTrailerBlockId(i));
+        // nibbles 0-11 are KeyA, 12-19 are the access bits, 20-31 are KeyB
+        quint32 accessMask = trailer.unknown & 0x000FF000u;
+        if (trailer.isEmpty()) {
+            trailer.length = 16;
+            memcpy(trailer.data + 6, defaultAccess, 4);
+            accessMask = 0;
+        }
+        const CardImage::Bytes &keyA = image->key(i, KEY_A);
+        const CardImage::Bytes &keyB = image->key(i, KEY_B);
+        memset(trailer.data, 0, 6);
+        memset(trailer.data + 10, 0, 6);
+        trailer.unknown = accessMask;
+        if (keyA.isKnown())
+            memcpy(trailer.data, keyA.data, 6);
         else
-            tmp += dataList->at(getTrailerBlockId(i)).midRef(12, 8);
-
-        if (data_isKeyValid(keyBList->at(i)))
-            tmp += keyBList->at(i);
+            trailer.unknown |= 0x00000FFFu;
+        if (keyB.isKnown())
+            memcpy(trailer.data + 10, keyB.data, 6);
         else
-            tmp += "????????????";
-
-        dataList->replace(getTrailerBlockId(i), tmp);
-        data_syncWithDataWidget();
+            trailer.unknown |= 0xFFF00000u;
     }
+    data_syncWithDataWidget();
 }
 
 void Mifare::data_data2Key() {
     for (int i = 0; i < cardType.sector_size; i++) {
-        if (dataList->at(getTrailerBlockId(i)) == "") {
-            keyAList->replace(i, "????????????");
-            keyBList->replace(i, "????????????");
+        const CardImage::Bytes &trailer = image->block(getTrailerBlockId(i));
+        CardImage::Bytes &keyA = image->key(i, KEY_A);
+        CardImage::Bytes &keyB = image->key(i, KEY_B);
+        if (trailer.isEmpty()) {
+            keyA = CardImage::Bytes::unknownBytes(6);
+            keyB = CardImage::Bytes::unknownBytes(6);
         } else {
-            keyAList->replace(i, dataList->at(getTrailerBlockId(i)).left(12));
-            keyBList->replace(i, dataList->at(getTrailerBlockId(i)).right(12));
+            keyA = CardImage::Bytes::fromRaw(reinterpret_cast<const char *>(trailer.data), 6);
+            keyA.unknown = trailer.unknown & 0xFFFu;
+            keyB = CardImage::Bytes::fromRaw(reinterpret_cast<const char *>(trailer.data + 10), 6);
+            keyB.unknown = (trailer.unknown >> 20) & 0xFFFu;
         }
-        data_syncWithKeyWidget();
     }
+    data_syncWithKeyWidget();
 }
 
 void Mifare::data_setData(int block, const QString &data) {
-    dataList->replace(block, data);
+    image->setBlockText(block, data);
 }
 
 void Mifare::data_setKey(int sector, KeyType keyType, const QString &key) {
     if (keyType == KEY_A)
-        keyAList->replace(sector, key);
+        image->setKeyText(sector, KEY_A, key);
     else
-        keyBList->replace(sector, key);
+        image->setKeyText(sector, KEY_B, key);
 }
 
 void Mifare::data_fillKeys() {
+    const CardImage::Bytes defaultKey = CardImage::Bytes::fromText("FFFFFFFFFFFF", 6);
     for (int i = 0; i < cardType.sector_size; i++) {
-        if (!data_isKeyValid(keyAList->at(i))) {
-            keyAList->replace(i, "FFFFFFFFFFFF");
+        if (!image->key(i, KEY_A).isKnown()) {
+            image->key(i, KEY_A) = defaultKey;
         }
-        if (!data_isKeyValid(keyBList->at(i))) {
-            keyBList->replace(i, "FFFFFFFFFFFF");
+        if (!image->key(i, KEY_B).isKnown()) {
+            image->key(i, KEY_B) = defaultKey;
         }
     }
     data_syncWithKeyWidget();
 }
 
+bool Mifare::data_openKeyStore(const QString &path) {
+    return keyStore->open(path);
+}
+
+int Mifare::data_fillStoredKeys(const QString &uid) {
+    // fill the unknown keys with the stored ones, returns how many are filled
+    int count = 0;
+    QByteArray uidBytes = HexCodec::decode(uid);
+    for (const KeyStore::CardKey &item : keyStore->cardKeys(uidBytes)) {
+        if (item.sector >= cardType.sector_size)
+            continue;
+        KeyType keyType = item.keyType == 'B' ? KEY_B : KEY_A;
+        if (image->key(item.sector, keyType).isKnown())
+            continue;
+        quint8 bytes[6];
+        KeyStore::keyToBytes(item.key, bytes);
+        image->key(item.sector, keyType) =
+            CardImage::Bytes::fromRaw(reinterpret_cast<const char *>(bytes), 6);
+        count++;
+    }
+    return count;
+}
+
+void Mifare::data_storeKeys() {
+    // keep all the known keys of the current card, e.g. from the key file of
+    // autopwn
+    for (int i = 0; i < cardType.sector_size; i++) {
+        storeKey(i, KEY_A);
+        storeKey(i, KEY_B);
+    }
+    keyStore->save();
+}
+
+void Mifare::data_setHardnestedKey(const QString &key) {
+    if (hardnestedSector < 0 || hardnestedSector >= cardType.sector_size ||
+        !data_isKeyValid(key))
+        return;
+    image->setKeyText(hardnestedSector, hardnestedKeyType, key);
+    data_syncWithKeyWidget(false, hardnestedSector, hardnestedKeyType);
+    storeKey(hardnestedSector, hardnestedKeyType);
+    keyStore->save();
+    hardnestedSector = -1;
+}
+
+void Mifare::data_setNonceDir(const QString &dir) {
+    nonceDir = dir;
+}
+
+QString Mifare::nonceFile(const QString &uid, int sector, KeyType keyType) {
+    return nonceDir + "/" + uid + "/" +
+           QString("sector%1_%2.bin").arg(sector, 2, 10, QChar('0')).arg(QChar(keyType));
+}
+
+void Mifare::data_setSolvedKey(const QString &uid, int sector, KeyType keyType,
+                               const QString &key) {
+    if (!data_isKeyValid(key))
+        return;
+    // the offline solver might finish after the card is taken away
+    if (uid == currUID && sector < cardType.sector_size) {
+        image->setKeyText(sector, keyType, key);
+        data_syncWithKeyWidget(false, sector, keyType);
+    }
+    keyStore->record(HexCodec::decode(uid), sector, (char)keyType,
+                     KeyStore::keyFromBytes(CardImage::Bytes::fromText(key, 6).data));
+    keyStore->save();
+}
+
+void Mifare::storeKey(int sector, KeyType keyType) {
+    const CardImage::Bytes &key = image->key(sector, keyType);
+    if (!key.isKnown())
+        return;
+    keyStore->record(HexCodec::decode(currUID), sector, (char)keyType,
+                     KeyStore::keyFromBytes(key.data));
+}
+
+bool Mifare::useStoredKeys() {
+    // look up the card on the reader in the key store before an attack,
+    // returns true if the attack can be skipped
+    QString uid = info(true)["UID"];
+    if (uid.isEmpty() || !keyStore->contains(HexCodec::decode(uid)))
+        return false;
+    int count = data_fillStoredKeys(uid);
+    if (count > 0)
+        data_syncWithKeyWidget();
+    for (int i = 0; i < cardType.sector_size; i++) {
+        if (!image->key(i, KEY_A).isKnown() || !image->key(i, KEY_B).isKnown())
+            return false;
+    }
+    QMessageBox::StandardButton choice = QMessageBox::question(
+        parent, tr("Info"),
+        tr("All keys of the card %1 are known from the key store(%2 filled).")
+                .arg(uid)
+                .arg(count) +
+            "\n" + tr("Skip the attack?"),
+        QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes);
+    return choice == QMessageBox::Yes;
+}
+
 int Mifare::data_b2s(int block) {
     if (block >= 0 && block < 128)
         return block / 4;
@@ -1788,12 +2321,14 @@ QList<quint8> Mifare::data_getACBits(
 }
 
 QString Mifare::data_getUID() {
-    if (data_isDataValid(dataList->at(0)))
-        return dataList->at(0).left(8);
+    if (!image->block(0).isEmpty())
+        return image->blockText(0).left(8);
     else
         return "";
 }
 
+const CardImage &Mifare::data_getImage() { return *image; }
+
 quint16 Mifare::getTrailerBlockId(quint8 sectorId, qint8 cardTypeId) {
     if (cardTypeId == 0)
         return (card_mini.blks[sectorId] + card_mini.blk[sectorId] - 1);
@@ -1825,6 +2360,10 @@ QString Mifare::getTraceSavePath() {
 
 void Mifare::autopwn() // <--- 必须带上 Mifare:: 前缀
 {
+    if (useStoredKeys())
+        return;
+    // autopwn prints its result in the same table as chk
+    startKeyRows("check", "hf mf autopwn");
     util->execCMD("hf mf autopwn");
     Util::gotoRawTab();
 }
@@ -1,7 +1,9 @@
 ﻿#ifndef MIFARE_H
 #define MIFARE_H
 
+#include "common/keystore.h"
 #include "common/util.h"
+#include "module/cardimage.h"
 #include "ui/mf_attack_hardnesteddialog.h"
 #include "ui/mf_sim_simdialog.h"
 #include "ui/mf_uid_parameterdialog.h"
@@ -69,10 +71,19 @@ public:
   void list();
   void readOne(TargetType targetType = TARGET_MIFARE);
   void readSelected(TargetType targetType = TARGET_MIFARE);
+  QStringList readAll();
   void writeOne(TargetType targetType = TARGET_MIFARE);
   void writeSelected(TargetType targetType = TARGET_MIFARE);
   void dump(const QString &keyFilename = "");
   void restore(const QString &dumpFilename = "", const QString &keyFilename = "", bool isBlankCard = false, bool force = false);
+  // the command builders are shared with the device pool
+  QString chkCmd(bool isForPool = false);
+  Util::ReturnTrigger chkTrigger();
+  QString dumpCmd(const QString &keyFilename = "");
+  QString restoreCmd(const QString &dumpFilename = "", const QString &keyFilename = "", bool isBlankCard = false, bool force = false);
+  // the offline hardnested solver works on the archived nonce files
+  QString offlineHardnestedCmd(const QString &nonceFilename);
+  QStringList offlineHardnestedArgs();
   void autopwn();     // 新增的自动攻击函数
   void scriptRf08s(); // 新增的 RF08S 脚本攻击函数
 
@@ -81,6 +92,7 @@ public:
   static bool data_isKeyValid(const QString &key);
   static Mifare::DataType data_isDataValid(const QString &data);
   void data_syncWithDataWidget(bool syncAll = true, int block = 0);
+  QString data_blockWithSpace(int block);
   void data_syncWithKeyWidget(bool syncAll = true, int sector = 0,
                               KeyType keyType = KEY_A);
 
@@ -106,42 +118,113 @@ public:
   void loadSniff(const QString &file);
   void saveSniff(const QString &file);
   void data_fillKeys();
+  bool data_openKeyStore(const QString &path);
+  int data_fillStoredKeys(const QString &uid);
+  void data_storeKeys();
+  void data_setHardnestedKey(const QString &key);
+  void data_setNonceDir(const QString &dir);
+  void data_setSolvedKey(const QString &uid, int sector, KeyType keyType,
+                         const QString &key);
+  void data_parseKeyRows(const QString &lines);
+  int data_keyRowCount();
 
   static QList<quint8> data_getACBits(const QString &text);
   static int data_b2s(int block);
   static bool data_isACBitsValid(const QString &text,
                                  QList<quint8> *returnHalfBytes = nullptr);
   QString data_getUID();
+  const CardImage &data_getImage();
   quint16 getTrailerBlockId(quint8 sectorId,
                             qint8 cardTypeId = -1); // -1: use current cardtype
   void setConfigMap(const QVariantMap &configMap);
   QString getTraceSavePath();
 public slots:
 signals:
+  // the nonces of a hardnested target are archived in file,
+  // isClientSolving: the client has started to solve them in the foreground
+  void noncesCollected(const QString &uid, int sector, char keyType,
+                       const QString &file, bool isClientSolving);
 
 private:
+  friend class MifareBench; // tests/bench times _readblk() and _readsec()
+
   QWidget *parent;
   Ui::MainWindow *ui;
   Util *util;
 
   QVariantMap configMap;
 
-  QStringList *keyAList;
-  QStringList *keyBList;
-  QStringList *dataList;
+  CardImage *image;
+  KeyStore *keyStore;
+  int hardnestedSector = -1; // the target of the running hardnested
+  KeyType hardnestedKeyType = KEY_A;
+  QString nonceDir; // the archive of the hardnested nonces, one folder per UID
+  QString nonceFile(const QString &uid, int sector, KeyType keyType);
+  bool useStoredKeys();
+  QString writeChkDictionary(const QString &uid, const QString &fileName);
+
+  // the key table of chk/nested/autopwn is parsed row by row as the output
+  // arrives, see data_parseKeyRows()
+  QRegularExpression keyRowPattern;
+  int keyRowAIndex = 0;
+  int keyRowBIndex = 0;
+  QString keyRowCmd; // the command whose output is parsed, "" if not parsing
+  int keyRowCount = 0;
+  void startKeyRows(const QString &section, const QString &cmd);
+  void storeKey(int sector, KeyType keyType);
+
+  // whether an rdsc with the current key of a sector has worked, so the read
+  // planner doesn't repeat the failing attempts
+  enum ReadResult {
+    READ_UNTRIED,
+    READ_OK,
+    READ_FAILED,
+  };
+  struct SectorReadCache {
+    CardImage::Bytes key[2]; // the keys the results belong to
+    ReadResult result[2];    // {KeyA, KeyB}
+    QList<quint8> ACBits;    // from the trailer read or written, empty if unknown
+    SectorReadCache() : result{READ_UNTRIED, READ_UNTRIED} {}
+  };
+  QVector<SectorReadCache> readCache;
+  QString currUID; // the card on the reader, from info()
   QRegularExpression *dataPattern;
   QRegularExpression *keyPattern_res;
   QRegularExpression *keyPattern;
-  QString bin2text(const QByteArray &buff, int start, int length);
 
   QString _readblk(int blockId, KeyType keyType, const QString &key,
                    TargetType targetType = TARGET_MIFARE, int waitTime = 300);
   QStringList _readsec(int sectorId, KeyType keyType, const QString &key,
                        TargetType targetType = TARGET_MIFARE,
                        int waitTime = 300);
+  QMap<int, QStringList> _readsecs(const QMap<int, KeyType> &plan,
+                                   int waitTime = 300);
+  static QString _matchedBlock(const QStringRef &text);
+  QStringList _parsesec(int sectorId, KeyType keyType, const QString &key,
+                        TargetType targetType, const QString &result);
+  void resetReadCache();
+  void _checkUID();
+  ReadResult getCachedRead(int sectorId, KeyType keyType);
+  void setCachedRead(int sectorId, KeyType keyType, ReadResult result);
+  QList<quint8> getKnownACBits(int sectorId);
+  void setKnownACBits(int sectorId, const QString &trailer);
+  int getACBitsIndex(int sectorId, int blockId);
+  bool isReadableBy(int sectorId, int blockId, KeyType keyType);
+  bool isWritableBy(int sectorId, int blockId, KeyType keyType);
+  QList<KeyType> _planSectorRead(int sectorId);
+  QMap<int, QStringList> _readPlanned(const QList<int> &sectorIds,
+                                      const QList<int> &selectedBlocks,
+                                      bool isReadingBlocks = true);
+  void _fillTrailerKeys(int sectorId, QString &trailer);
   bool _writeblk(int blockId, KeyType keyType, const QString &key,
                  const QString &data, TargetType targetType = TARGET_MIFARE,
                  int waitTime = 300);
+  QString _writeblkCmd(int blockId, KeyType keyType, const QString &key,
+                       const QString &data);
+  bool _isWriteSucceeded(const QString &result, const QVariantMap &config);
+  typedef QPair<KeyType, QString> WriteKey; // {key type, key}
+  QList<WriteKey> _planBlockWrite(int blockId, const WriteKey &lastWorked);
+  QList<int> _writePlanned(const QList<int> &blockIds);
 };
 
 #endif // MIFARE_H
@@ -0,0 +1,141 @@
+﻿#include "provisioner.h"
+
+Provisioner::Provisioner(Mifare *mifare, Util *addr, QObject *parent)
+    : QObject(parent) {
+    this->mifare = mifare;
+    util = addr;
+}
+
+bool Provisioner::start(const QString &dumpFilename,
+                        const QString &keyFilename) {
+    if (running)
+        return false;
+    // the template is shown in the data widget, and its trailers are the keys
+    // for the read back
+    if (!mifare->data_loadDataFile(dumpFilename))
+        return false;
+    mifare->data_data2Key();
+    templateData = mifare->data_getImage();
+    this->dumpFilename = dumpFilename;
+    this->keyFilename = keyFilename;
+    records.clear();
+    lastUID.clear();
+    elapsedTimer.start();
+
+    running = true;
+    while (running)
+        processCard();
+    emit stageChanged(STAGE_IDLE);
+    return true;
+}
+
+void Provisioner::stop() { running = false; }
+
+bool Provisioner::isRunning() { return running; }
+
+void Provisioner::processCard() {
+    Record record;
+    QElapsedTimer stageTimer;
+    QString uid;
+
+    emit stageChanged(STAGE_WAIT);
+    stageTimer.start();
+    // the finished card must leave the field before a new one is accepted
+    while (running) {
+        uid = mifare->info(true).value("UID");
+        if (uid.isEmpty())
+            lastUID.clear();
+        else if (uid != lastUID)
+            break;
+        util->delay(pollInterval);
+    }
+    if (!running)
+        return;
+    record.time = QDateTime::currentDateTime();
+    record.uid = uid;
+    record.waitTime = stageTimer.restart();
+
+    emit stageChanged(STAGE_WRITE);
+    // not framed by the prompt(the sentinel might abort the restore), so wait
+    // for the "Done!" at the end of the restore
+    util->execCMDWithOutput(
+        mifare->restoreCmd(dumpFilename, keyFilename, keyFilename.isEmpty()),
+        Util::ReturnTrigger(5000, {"Done!"}), true);
+    record.writeTime = stageTimer.restart();
+
+    emit stageChanged(STAGE_READ);
+    QStringList data = mifare->readAll();
+    record.readTime = stageTimer.restart();
+
+    emit stageChanged(STAGE_VERIFY);
+    record.mismatchedBlocks = compare(data);
+    record.isPassed = (record.mismatchedBlocks == 0);
+    record.verifyTime = stageTimer.elapsed();
+
+    lastUID = uid;
+    records.append(record);
+    emit cardFinished(record);
+}
+
+int Provisioner::compare(const QStringList &data) {
+    // block 0 is not written by restore.
+    // '?' means unknown(like the KeyB which cannot be read by KeyA), it matches
+    // anything.
+    int result = 0;
+    for (int i = 1; i < templateData.blockCount() && i < data.size(); i++) {
+        const CardImage::Bytes &expected = templateData.block(i);
+        CardImage::Bytes actual = CardImage::Bytes::fromText(data[i], 16);
+        if (actual.isEmpty() || !actual.matches(expected))
+            result++;
+    }
+    return result;
+}
+
+const QList<Provisioner::Record> &Provisioner::getRecords() { return records; }
+
+double Provisioner::getCardsPerMinute() {
+    int passed = 0;
+    for (const Record &record : records) {
+        if (record.isPassed)
+            passed++;
+    }
+    qint64 elapsed = elapsedTimer.isValid() ? elapsedTimer.elapsed() : 0;
+    return elapsed > 0 ? passed * 60000.0 / elapsed : 0;
+}
+
+Provisioner::Record Provisioner::getAverage() {
+    Record result = {QDateTime(), "", true, 0, 0, 0, 0, 0};
+    if (records.isEmpty())
+        return result;
+    for (const Record &record : records) {
+        result.mismatchedBlocks += record.mismatchedBlocks;
+        result.waitTime += record.waitTime;
+        result.writeTime += record.writeTime;
+        result.readTime += record.readTime;
+        result.verifyTime += record.verifyTime;
+    }
+    result.mismatchedBlocks /= records.size();
+    result.waitTime /= records.size();
+    result.writeTime /= records.size();
+    result.readTime /= records.size();
+    result.verifyTime /= records.size();
+    return result;
+}
+
+bool Provisioner::exportCSV(const QString &filename) {
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+    QTextStream out(&file);
+    out << "time,uid,result,mismatched blocks,wait(ms),write(ms),read(ms),"
+           "verify(ms)\n";
+    for (const Record &record : records) {
+        out << record.time.toString(Qt::ISODate) << "," << record.uid << ","
+            << (record.isPassed ? "pass" : "fail") << ","
+            << record.mismatchedBlocks << "," << record.waitTime << ","
+            << record.writeTime << "," << record.readTime << ","
+            << record.verifyTime << "\n";
+    }
+    file.close();
+    return true;
+}
@@ -0,0 +1,71 @@
+﻿#ifndef PROVISIONER_H
+#define PROVISIONER_H
+
+#include "common/util.h"
+#include "module/mifare.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+// Writes a template dump to card after card:
+// wait for a new card -> write -> read back -> verify, then wait for the next one
+class Provisioner : public QObject {
+  Q_OBJECT
+public:
+  explicit Provisioner(Mifare *mifare, Util *addr, QObject *parent = nullptr);
+
+  enum Stage {
+    STAGE_IDLE,
+    STAGE_WAIT,
+    STAGE_WRITE,
+    STAGE_READ,
+    STAGE_VERIFY,
+  };
+  Q_ENUM(Provisioner::Stage)
+
+  struct Record {
+    QDateTime time;
+    QString uid;
+    bool isPassed;
+    int mismatchedBlocks;
+    qint64 waitTime; // ms
+    qint64 writeTime;
+    qint64 readTime;
+    qint64 verifyTime;
+  };
+
+  bool start(const QString &dumpFilename, const QString &keyFilename = "");
+  void stop();
+  bool isRunning();
+
+  const QList<Record> &getRecords();
+  double getCardsPerMinute();
+  Record getAverage();
+  bool exportCSV(const QString &filename);
+
+  int pollInterval = 300; // ms between two "hf 14a info"
+signals:
+  void stageChanged(Provisioner::Stage stage);
+  void cardFinished(const Provisioner::Record &record);
+
+private:
+  Mifare *mifare;
+  Util *util;
+  bool running = false;
+  QString dumpFilename;
+  QString keyFilename;
+  CardImage templateData;
+  QString lastUID;
+  QList<Record> records;
+  QElapsedTimer elapsedTimer;
+
+  void processCard();
+  int compare(const QStringList &data);
+};
+
+#endif // PROVISIONER_H
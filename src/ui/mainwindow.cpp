@@ -66,8 +66,15 @@ MainWindow::MainWindow(QWidget *parent)
     util = new Util(this);
     Util::setUI(ui);
     mifare = new Mifare(ui, util, this);
+    // the recovered keys are kept beside the settings
+    if (!mifare->data_openKeyStore(QFileInfo(iniPath).absolutePath() + "/keystore.bin"))
+        qCWarning(lcUI) << "failed to open the key store";
+    mifare->data_setNonceDir(QFileInfo(iniPath).absolutePath() + "/nonces");
     lf = new LF(ui, util, this);
     t55xxTab = new T55xxTab(util);
+    devicePool = new DevicePool(this);
+    solverPool = new SolverPool(this);
+    provisioner = new Provisioner(mifare, util, this);
     connect(lf, &LF::LFfreqConfChanged, this, &MainWindow::onLFfreqConfChanged);
     connect(t55xxTab, &T55xxTab::setParentGUIState, this, &MainWindow::setState);
     ui->funcTab->insertTab(2, t55xxTab, tr("T55xx"));
@@ -106,6 +113,11 @@ MainWindow::MainWindow(QWidget *parent)
 MainWindow::~MainWindow() {
     // 1. 先发送停止信号，通知后台处理结束
     emit killPM3();
+    if (standbyThread && standbyThread->isRunning()) {
+        QMetaObject::invokeMethod(standby, "killPM3", Qt::BlockingQueuedConnection);
+        standbyThread->quit();
+        standbyThread->wait(5000);
+    }
 
     // 2. 安全优雅地退出线程
     if (pm3Thread && pm3Thread->isRunning()) {
@@ -117,6 +129,7 @@ MainWindow::~MainWindow() {
     // 因为它们会自动被 Qt 回收，强行 delete 会导致 macOS 报 SIGSEGV 崩溃。
 
     // 3. 确保后台线程完全停止后，再销毁 UI 组件，防止子线程异步更新访问到空指针
+    delete consoleLog;
     delete ui;
 }
 
@@ -124,7 +137,7 @@ void MainWindow::loadConfig() {
     QString filename = ui->Set_Client_configFileBox->currentData().toString();
     if (filename == "(ext)")
         filename = ui->Set_Client_configPathEdit->text();
-    qDebug() << "config file:" << filename;
+    qCDebug(lcUI) << "config file:" << filename;
     QFile configList(filename);
     if (!configList.open(QFile::ReadOnly | QFile::Text)) {
         QMessageBox::information(this, tr("Info"),
@@ -134,9 +147,15 @@ void MainWindow::loadConfig() {
 
     QByteArray configData = configList.readAll();
     QJsonDocument configJson(QJsonDocument::fromJson(configData));
+    util->setConfigMap(
+        configJson.object()["client"].toObject().toVariantMap());
+    standbyConnectCmd =
+        configJson.object()["client"].toObject()["standby connect"].toString();
     mifare->setConfigMap(
         configJson.object()["mifare classic"].toObject().toVariantMap());
     lf->setConfigMap(configJson.object()["lf"].toObject().toVariantMap());
+    setOutputPatterns(
+        configJson.object()["output"].toObject().toVariantMap());
     t55xxTab->setConfigMap(
         configJson.object()["t55xx"].toObject().toVariantMap());
 }
@@ -207,7 +226,7 @@ void MainWindow::on_portSearchTimer_timeout() {
 }
 
 void MainWindow::on_PM3_connectButton_clicked() {
-    qDebug() << "Main:" << QThread::currentThread();
+    qCDebug(lcUI) << "Main:" << QThread::currentThread();
 
     const QComboBox *portBox = ui->PM3_portBox;
     QString port;
@@ -217,7 +236,7 @@ void MainWindow::on_PM3_connectButton_clicked() {
     else
         // not in the list
         port = portBox->currentText();
-    qDebug() << "port:" << port;
+    qCDebug(lcUI) << "port:" << port;
     QString startArgs = ui->Set_Client_startArgsEdit->text();
     QString clientPath = ui->PM3_pathBox->currentText();
     QFileInfo clientFile(clientPath);
@@ -258,72 +277,164 @@ void MainWindow::on_PM3_connectButton_clicked() {
     if (!startArgs.contains("<port>")) // no <port>
         port = "";                       // a symbol
 
-    QStringList args = startArgs.replace("<port>", port).split(' ');
+    QStringList args = clientArgs(startArgs, port);
     addClientPath(clientPath);
 
-    QProcess envSetProcess;
+    QString scriptPath = clientEnvScript(clientPath);
+    if (scriptPath.isEmpty()) {
+        clientEnv.clear();
+        finishConnect(clientPath, args, port);
+        return;
+    }
+    qCDebug(lcUI) << scriptPath;
+    if (scriptPath == envCacheScript) {
+        // spawn with the environment resolved last time, and refresh it for
+        // the next connection at the same time
+        clientEnv = envCache;
+        emit setProcEnv(&clientEnv);
+        finishConnect(clientPath, args, port);
+        resolveClientEnv(scriptPath, nullptr);
+    } else {
+        setStatusBar(connectStatusBar, tr("Connecting"));
+        resolveClientEnv(scriptPath, [=]() {
+            // if the script has failed or timed out, the cache still belongs
+            // to another script
+            if (envCacheScript == scriptPath)
+                clientEnv = envCache;
+            else
+                clientEnv.clear();
+            // an empty list makes the client inherit the environment of the GUI
+            emit setProcEnv(&clientEnv);
+            finishConnect(clientPath, args, port);
+        });
+    }
+}
+
+QStringList MainWindow::clientArgs(QString startArgs, const QString &port) const {
+    // repeated spaces don't make empty arguments
+#if (QT_VERSION <= QT_VERSION_CHECK(5, 14, 0))
+    return startArgs.replace("<port>", port).split(' ', QString::SkipEmptyParts);
+#else
+    return startArgs.replace("<port>", port).split(' ', Qt::SkipEmptyParts);
+#endif
+}
+
+QString MainWindow::clientEnvScript(const QString &clientPath) const {
+    // the absolute path of the environment script, "" if it doesn't exist
     QString envScriptPath = ui->Set_Client_envScriptEdit->text();
     if (envScriptPath.contains("<client dir>"))
         envScriptPath.replace("<client dir>",
-                              clientFile.absoluteDir().absolutePath());
+                              QFileInfo(clientPath).absoluteDir().absolutePath());
 
     QFileInfo envScript(envScriptPath);
-    if (envScript.exists()) {
-        qDebug() << envScript.absoluteFilePath();
-        // use the shell session to keep the environment then read it
-#ifdef Q_OS_WIN
-        // cmd /c "<path>">>nul && set
-        envSetProcess.start(
-            "cmd", {}, QProcess::Unbuffered | QProcess::ReadWrite | QProcess::Text);
-        envSetProcess.write(
-            QString("\"" + envScript.absoluteFilePath() + "\">>nul\n").toLatin1());
-        envSetProcess.waitForReadyRead(10000);
-        envSetProcess.readAll();
-        envSetProcess.write("set\n");
+    if (!envScript.exists())
+        return "";
+    return envScript.absoluteFilePath();
+}
+
+void MainWindow::resolveClientEnv(const QString &scriptPath,
+                                  std::function<void()> onResolved) {
+    // run the script in a shell session then read the environment, without
+    // blocking the UI. The result is kept in envCache.
+    if (onResolved)
+        envResolvedCallbacks.append(onResolved);
+    if (envSetProcess != nullptr) {
+        // the same script is running, wait for it
+        if (envSetScript == scriptPath)
+            return;
+        // another script is running, the new request takes over. The pending
+        // callbacks are called once the new one finishes.
+        envSetProcess->disconnect(this);
+        envSetProcess->kill();
+        envSetProcess->deleteLater();
+    }
+    envSetProcess = new QProcess(this);
+    envSetScript = scriptPath;
+    QProcess *process = envSetProcess;
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, [=]() {
+                QStringList env;
+                const QString output = QString(process->readAll());
+#if (QT_VERSION <= QT_VERSION_CHECK(5, 14, 0))
+                const QStringList lines = output.split("\n", QString::SkipEmptyParts);
 #else
-        // need implementation(or test if space works)
-        // sh -c '. "<path>">>/dev/null && env'
-        envSetProcess.start("sh -c \' . \"" + envScript.absoluteFilePath() +
-                            "\">>/dev/null && env");
+                const QStringList lines = output.split("\n", Qt::SkipEmptyParts);
 #endif
-        envSetProcess.waitForReadyRead(10000);
-        QString envSetResult = QString(envSetProcess.readAll());
-#if (QT_VERSION <= QT_VERSION_CHECK(5, 14, 0))
-        clientEnv = envSetResult.split("\n", QString::SkipEmptyParts);
+                // only keep the NAME=VALUE lines, the banner, echoes and
+                // prompts of the shell are dropped
+                QRegularExpression envLine("^[^\\s=][^=]*=");
+                for (const QString &line : lines) {
+                    if (envLine.match(line).hasMatch())
+                        env.append(line.trimmed());
+                }
+                if (!env.isEmpty()) {
+                    envCache = env;
+                    envCacheScript = scriptPath;
+                }
+                envSetProcess = nullptr;
+                envSetScript.clear();
+                process->deleteLater();
+                const QList<std::function<void()>> callbacks = envResolvedCallbacks;
+                envResolvedCallbacks.clear();
+                for (const std::function<void()> &callback : callbacks)
+                    callback();
+            });
+    // the old limit of the blocking version
+    QTimer::singleShot(10000, process, &QProcess::kill);
+#ifdef Q_OS_WIN
+    // cmd /c "<path>">>nul && set
+    process->start("cmd", {}, QProcess::Unbuffered | QProcess::ReadWrite | QProcess::Text);
+    process->write(QString("\"" + scriptPath + "\">>nul\n").toLatin1());
+    process->write("set\n");
+    process->write("exit\n");
 #else
-        clientEnv = envSetResult.split("\n", Qt::SkipEmptyParts);
+    // sh -c '. "<path>">>/dev/null && env'
+    process->start("sh", {"-c", ". \"" + scriptPath + "\">>/dev/null && env"});
 #endif
-        if (clientEnv.size() > 2) // the first element is "set" and the last element
-        // is the current path
-        {
-            clientEnv.removeFirst();
-            clientEnv.removeLast();
-            emit setProcEnv(&clientEnv);
-        }
-        //      qDebug() << "Get Env List" << clientEnv;
-    } else
-        clientEnv.clear();
+}
 
+void MainWindow::updateClientWorkingDir() {
     clientWorkingDir->setPath(QApplication::applicationDirPath());
-    qDebug() << clientWorkingDir->absolutePath();
+    qCDebug(lcUI) << clientWorkingDir->absolutePath();
     clientWorkingDir->mkpath(ui->Set_Client_workingDirEdit->text());
-    qDebug() << clientWorkingDir->absolutePath();
+    qCDebug(lcUI) << clientWorkingDir->absolutePath();
     clientWorkingDir->cd(ui->Set_Client_workingDirEdit->text());
-    qDebug() << clientWorkingDir->absolutePath();
+    qCDebug(lcUI) << clientWorkingDir->absolutePath();
+}
+
+void MainWindow::finishConnect(const QString &clientPath,
+                               const QStringList &args, const QString &port) {
+    updateClientWorkingDir();
     emit setWorkingDir(clientWorkingDir->absolutePath());
 
     loadConfig();
+    // the offline solvers share the client and its environment
+    solverPool->setClient(clientPath, mifare->offlineHardnestedArgs());
+    solverPool->setProcEnv(clientEnv);
+    solverPool->setWorkingDir(clientWorkingDir->absolutePath());
     emit connectPM3(clientPath, args);
     if (port != "" && !keepClientActive)
         emit setSerialListener(port, true);
     else if (!keepClientActive)
         emit setSerialListener(false);
 
-    envSetProcess.kill();
+    currClientPath = clientPath;
+    currClientPort = port;
+    currClientArgs = args;
+#if (QT_VERSION <= QT_VERSION_CHECK(5, 14, 0))
+    standbyArgs = ui->Set_Client_standbyArgsEdit->text().split(' ', QString::SkipEmptyParts);
+#else
+    standbyArgs = ui->Set_Client_standbyArgsEdit->text().split(' ', Qt::SkipEmptyParts);
+#endif
+    startStandby();
 }
 
 void MainWindow::onPM3ErrorOccurred(QProcess::ProcessError error) {
-    qDebug() << "PM3 Error:" << error << pm3->errorString();
+    if (sender() != pm3)
+        return; // from a client which has been replaced by the standby
+    qCWarning(lcUI) << "PM3 Error:" << error << pm3->errorString();
+    if (error == QProcess::Crashed && promoteStandby())
+        return;
     if (error == QProcess::FailedToStart)
         QMessageBox::information(this, tr("Info"),
                                  tr("Failed to start the client") + "\n" +
@@ -331,11 +442,14 @@ void MainWindow::onPM3ErrorOccurred(QProcess::ProcessError error) {
 }
 
 void MainWindow::onPM3HWConnectFailed() {
+    setStatusBar(connectStatusBar, tr("Not Connected"));
     QMessageBox::information(this, tr("Info"),
                              tr("Failed to connect to the hardware"));
 }
 
 void MainWindow::onPM3StateChanged(bool st, const QString &info) {
+    if (sender() != nullptr && sender() != pm3)
+        return; // from a client which has been replaced by the standby
     pm3state = st;
     setState(st);
     if (st == true) {
@@ -350,15 +464,280 @@ void MainWindow::onPM3StateChanged(bool st, const QString &info) {
 }
 
 void MainWindow::on_PM3_disconnectButton_clicked() {
+    stopStandby();
     emit killPM3();
     emit setSerialListener(false);
 }
 
-void MainWindow::refreshOutput(const QString &output) {
-    // 原有的控制台文本插入逻辑
+void MainWindow::onPM3ClientLost() {
+    if (sender() == pm3)
+        promoteStandby();
+}
+
+// ******************** warm standby ********************
+
+void MainWindow::attachPM3(PM3Process *process) {
+    connect(process, &PM3Process::newOutput, util, &Util::processOutput);
+    connect(process, &PM3Process::changeClientType, util, &Util::setClientType);
+    connect(this, &MainWindow::connectPM3, process, &PM3Process::connectPM3);
+    connect(this, &MainWindow::reconnectPM3, process, &PM3Process::reconnectPM3);
+    connect(process, &PM3Process::PM3StatedChanged, this,
+            &MainWindow::onPM3StateChanged);
+    connect(process, &PM3Process::PM3StatedChanged, util, &Util::setRunningState);
+    connect(process, &PM3Process::errorOccurred, this,
+            &MainWindow::onPM3ErrorOccurred);
+    connect(process, &PM3Process::HWConnectFailed, this,
+            &MainWindow::onPM3HWConnectFailed);
+    connect(process, &PM3Process::clientLost, this, &MainWindow::onPM3ClientLost);
+    connect(this, &MainWindow::killPM3, process, &PM3Process::killPM3);
+    connect(this, &MainWindow::setProcEnv, process, &PM3Process::setProcEnv);
+    connect(this, &MainWindow::setWorkingDir, process,
+            &PM3Process::setWorkingDir);
+    connect(this, QOverload<bool>::of(&MainWindow::setSerialListener), process,
+            QOverload<bool>::of(&PM3Process::setSerialListener));
+    connect(this,
+            QOverload<const QString &, bool>::of(&MainWindow::setSerialListener),
+            process,
+            QOverload<const QString &, bool>::of(&PM3Process::setSerialListener));
+
+    connect(util, &Util::write, process, &PM3Process::write);
+}
+
+void MainWindow::detachPM3(PM3Process *process) {
+    disconnect(process, nullptr, util, nullptr);
+    disconnect(process, nullptr, this, nullptr);
+    disconnect(this, nullptr, process, nullptr);
+    disconnect(util, nullptr, process, nullptr);
+}
+
+bool MainWindow::isOfflineStandby() const {
+    // an offline standby connects to the port of the main connection when it
+    // takes over, otherwise it has a device of its own
+    return standbyArgs.contains("--offline") || standbyArgs.contains("-o");
+}
+
+void MainWindow::startStandby() {
+    // start a spare client with the same path, environment and working
+    // directory, it is parked after the banner
+    if (standbyArgs.isEmpty()) {
+        stopStandby();
+        return;
+    }
+    if (standby == nullptr) {
+        standbyThread = new QThread(this);
+        connect(QApplication::instance(), &QApplication::aboutToQuit,
+                standbyThread, &QThread::quit);
+        standby = new PM3Process(standbyThread);
+        connect(standbyThread, &QThread::finished, standby,
+                &PM3Process::deleteLater);
+        standbyThread->start();
+    }
+    // detachPM3() drops it when the client is swapped
+    connect(standby, &PM3Process::standbyStateChanged, this,
+            &MainWindow::onStandbyStateChanged, Qt::UniqueConnection);
+    isStandbyReady = false;
+    QMetaObject::invokeMethod(standby, "prepareStandby", Qt::QueuedConnection,
+                              Q_ARG(QString, currClientPath),
+                              Q_ARG(QStringList, standbyArgs),
+                              Q_ARG(QStringList, clientEnv),
+                              Q_ARG(QString, clientWorkingDir->absolutePath()));
+}
+
+void MainWindow::stopStandby() {
+    isStandbyReady = false;
+    if (standby != nullptr)
+        QMetaObject::invokeMethod(standby, "killPM3", Qt::QueuedConnection);
+    connectStatusBar->setToolTip("");
+}
+
+void MainWindow::onStandbyStateChanged(bool isReady) {
+    if (sender() != standby)
+        return;
+    isStandbyReady = isReady;
+    qCInfo(lcUI) << "standby client ready:" << isReady;
+    connectStatusBar->setToolTip(isReady ? tr("Standby client: ready")
+                                         : tr("Standby client: failed"));
+}
+
+bool MainWindow::promoteStandby() {
+    // swap the parked client in, then park the failed one instead.
+    // The parked client has started and printed its banner, so it is ready
+    // after a single "hw version"(and "hw connect" if it's offline)
+    if (standby == nullptr || !isStandbyReady)
+        return false;
+    qCInfo(lcUI) << "the standby client takes over";
+    detachPM3(pm3);
+    // nothing may be written into the handshake of the promoted client, the
+    // running wait returns now. Its PM3StatedChanged(true) turns Util on again.
+    util->setRunningState(false);
+    // the failed client might still hold the serial port, which an offline
+    // standby is about to connect to
+    QMetaObject::invokeMethod(pm3, "killPM3", Qt::BlockingQueuedConnection);
+    qSwap(pm3, standby);
+    qSwap(pm3Thread, standbyThread);
+    isStandbyReady = false;
+    attachPM3(pm3);
+
+    QString connectCmd;
+    QStringList reconnectArgs;
+    if (isOfflineStandby()) {
+        connectCmd = QString(standbyConnectCmd).replace("<port>", currClientPort);
+        // a later reconnect should go to the hardware directly
+        reconnectArgs = currClientArgs;
+    } else {
+        // the spare device becomes the main one, and the failed one the spare
+        qSwap(currClientArgs, standbyArgs);
+        currClientPort = "";
+    }
+    QMetaObject::invokeMethod(pm3, "promote", Qt::QueuedConnection,
+                              Q_ARG(QString, connectCmd),
+                              Q_ARG(QStringList, reconnectArgs));
+    if (currClientPort != "" && !keepClientActive)
+        emit setSerialListener(currClientPort, true);
+    else if (!keepClientActive)
+        emit setSerialListener(false);
+    startStandby();
+    return true;
+}
+
+void MainWindow::appendConsole(const QString &text) {
+    // Raw_outputEdit drops the oldest lines beyond its maximumBlockCount, and
+    // QPlainTextEdit only lays out the visible lines, so the cost of an append
+    // doesn't grow with the session. The log file keeps the dropped lines.
     ui->Raw_outputEdit->moveCursor(QTextCursor::End);
-    ui->Raw_outputEdit->insertPlainText(output);
+    ui->Raw_outputEdit->insertPlainText(text);
     ui->Raw_outputEdit->moveCursor(QTextCursor::End);
+    if (consoleLog != nullptr)
+        consoleLog->write(text.toUtf8());
+}
+
+void MainWindow::setConsoleLog(bool st) {
+    delete consoleLog;
+    consoleLog = nullptr;
+    if (!st)
+        return;
+    consoleLog = new QFile(ui->Set_Console_logPathEdit->text());
+    if (!consoleLog->open(QIODevice::WriteOnly | QIODevice::Append)) {
+        QMessageBox::information(this, tr("Info"),
+                                 tr("Failed to open the log file") + "\n" +
+                                     consoleLog->fileName());
+        delete consoleLog;
+        consoleLog = nullptr;
+        ui->Set_Console_logBox->blockSignals(true);
+        ui->Set_Console_logBox->setChecked(false);
+        ui->Set_Console_logBox->blockSignals(false);
+        return;
+    }
+    consoleLog->write(("\n==== " +
+                       QDateTime::currentDateTime().toString(Qt::ISODate) +
+                       " ====\n")
+                          .toUtf8());
+}
+
+void MainWindow::setOutputPatterns(const QVariantMap &configMap) {
+    // the order is the same as OutputPattern. The config file overrides the
+    // built-in patterns, the missing or unsupported ones keep them
+    static const char *const names[OUTPUT_PATTERN_COUNT] = {
+        "magic gen3", "fm11rf08s",      "static nonce",      "weak prng",
+        "hardened",   "key file",       "dump file",         "hardnested key",
+        "hardnested failed",            "task done"};
+    static const char *const defaults[OUTPUT_PATTERN_COUNT] = {
+        "Magic capabilities\\.\\.\\. Gen 3",
+        "Hint: Try `script run fm11rf08s_recovery\\.py",
+        "\\[\\+\\] Static (?:enc )?nonce\\.\\.\\. yes",
+        "\\[\\+\\] Prng\\.\\.\\.\\.\\.\\.\\. weak",
+        "Hardened MIFARE Classic|\\[\\+\\] Prng\\.\\.\\.\\.\\.\\.\\. hard",
+        "(?:saved to file|dumped to)\\s+[`']?([^`'\\n\\r]+-key(?:-[0-9]+)?\\.bin)[`']?",
+        "(?:saved to file|dumped to|to binary file)\\s+[`']?([^`'\\n\\r]+-dump(?:-[0-9]+)?\\.bin)[`']?",
+        "(?:found valid key|Key found):?\\s*([0-9a-fA-F]{12})",
+        "Hardnested attack failed|not vulnerable to hardnested",
+        "\\[=\\] Done!|verify failed"};
+    outputPatterns.clear();
+    for (int i = 0; i < OUTPUT_PATTERN_COUNT; i++) {
+        QString pattern = configMap.value(names[i]).toString();
+        if (!pattern.isEmpty() && !PatternSet::isSupported(pattern)) {
+            qCWarning(lcUI) << "unsupported output pattern" << names[i]
+                            << ", the built-in one is used";
+            pattern.clear();
+        }
+        if (pattern.isEmpty())
+            pattern = defaults[i];
+        outputPatterns.add(pattern);
+        if (i == OUTPUT_HN_KEY)
+            solverPool->setKeyPattern(pattern);
+    }
+    outputPatterns.compile(QRegularExpression::CaseInsensitiveOption);
+}
+
+QString MainWindow::cmdPrompt() {
+    // the prompt in the config file, the framing might be disabled there
+    QString prompt = util->getPrompt();
+    return prompt.isEmpty() ? "pm3 -->" : prompt;
+}
+
+QString MainWindow::updateCMDBlock(const QString &output) {
+    // Keeps the output since the last prompt(the current command and its
+    // response) in currCMDBlock, so nothing has to scan the whole console.
+    // Returns the lines completed by this chunk, each line is returned once.
+    const QString prompt = cmdPrompt();
+    int from = qMax(0, currCMDBlock.length() - prompt.length() + 1);
+    currCMDBlock += output;
+    int lastPromptPos = -1;
+    for (int pos = currCMDBlock.indexOf(prompt, from); pos != -1;
+         pos = currCMDBlock.indexOf(prompt, pos + prompt.length()))
+        lastPromptPos = pos;
+
+    QString result;
+    int lineEnd = currCMDBlock.lastIndexOf('\n') + 1;
+    if (lineEnd > CMDBlockScanned) {
+        result = currCMDBlock.mid(CMDBlockScanned, lineEnd - CMDBlockScanned);
+        CMDBlockScanned = lineEnd;
+    }
+    if (lastPromptPos != -1) {
+        currCMDBlock.remove(0, lastPromptPos);
+        CMDBlockScanned = qMax(0, CMDBlockScanned - lastPromptPos);
+    }
+
+    // A command without a prompt for a long time(sniffing, hardnested) would
+    // grow the block without limit. Only the tail is kept then, together with
+    // the command line at the head, which the task recognizers look at.
+    static const int maxBlockLength = 1024 * 1024;
+    static const int keptTailLength = 256 * 1024;
+    if (currCMDBlock.length() > maxBlockLength) {
+        int headLength = 0;
+        if (currCMDBlock.startsWith(prompt)) {
+            headLength = currCMDBlock.indexOf('\n') + 1;
+            if (headLength > keptTailLength)
+                headLength = 0;
+        }
+        int removed = currCMDBlock.length() - keptTailLength - headLength;
+        currCMDBlock.remove(headLength, removed);
+        // the removed part has been returned already, unless a single line
+        // is longer than the tail
+        CMDBlockScanned = qMax(headLength, CMDBlockScanned - removed);
+    }
+    return result;
+}
+
+void MainWindow::refreshOutput(const QString &output) {
+    // 原有的控制台文本插入逻辑
+    appendConsole(output);
+    // the recognizers below only run on the lines completed by this chunk
+    const QString newLines = updateCMDBlock(output);
+    if (newLines.isEmpty())
+        return;
+    // the key table of chk/nested/autopwn goes to the key widget row by row
+    mifare->data_parseKeyRows(newLines);
+    // one pass over the new lines for all recognizers, the first match of
+    // each one is kept
+    QVector<bool> isMatched(OUTPUT_PATTERN_COUNT, false);
+    QVector<QString> captured(OUTPUT_PATTERN_COUNT);
+    for (const PatternSet::Match &match : outputPatterns.scan(newLines)) {
+        if (!isMatched[match.id]) {
+            isMatched[match.id] = true;
+            captured[match.id] = match.captured;
+        }
+    }
 
     // ==========================================
     // 智能破解建议逻辑区 (防连弹延迟触发版)
@@ -373,16 +752,10 @@ void MainWindow::refreshOutput(const QString &output) {
         suggestTimer->setInterval(500);
 
         connect(suggestTimer, &QTimer::timeout, this, [this]() {
-            QString allText = ui->Raw_outputEdit->toPlainText();
             QString prefix = "";
 
             // ✨ 核心修复：只检查最后一次命令的输出，防止历史记录污染
-            QString lastCommandBlock = allText;
-            int lastPromptIdx = allText.lastIndexOf("pm3 -->");
-            if (lastPromptIdx != -1) {
-                // 截取从最后一次敲命令到现在的文本
-                lastCommandBlock = allText.mid(lastPromptIdx);
-            }
+            const QString &lastCommandBlock = currCMDBlock;
 
             // 使用截取后的最新输出块来判断是否为魔术卡
             if (lastCommandBlock.contains("Gen 2 / CUID", Qt::CaseInsensitive)) {
@@ -427,25 +800,23 @@ void MainWindow::refreshOutput(const QString &output) {
     bool needStartTimer = false;
 
     // ✨ 修复：精确匹配终端输出特征词，严防误判
-    if (output.contains("Magic capabilities... Gen 3", Qt::CaseInsensitive)) {
+    if (isMatched[OUTPUT_MAGIC_GEN3]) {
         if (currentVulnLevel < 5) currentVulnLevel = 5; // 魔术卡三代 (APDU卡)
         needStartTimer = true;
     }
-    else if (output.contains("Hint: Try `script run fm11rf08s_recovery.py", Qt::CaseInsensitive)) {
+    else if (isMatched[OUTPUT_FM11RF08S]) {
         if (currentVulnLevel < 4) currentVulnLevel = 4; // 真正的复旦三代 (FM11RF08S)
         needStartTimer = true;
     }
-    else if (output.contains("[+] Static nonce... yes", Qt::CaseInsensitive) ||
-             output.contains("[+] Static enc nonce... yes", Qt::CaseInsensitive)) {
+    else if (isMatched[OUTPUT_STATIC_NONCE]) {
         if (currentVulnLevel < 3) currentVulnLevel = 3; // 静态随机数
         needStartTimer = true;
     }
-    else if (output.contains("[+] Prng....... weak", Qt::CaseInsensitive)) {
+    else if (isMatched[OUTPUT_WEAK_PRNG]) {
         if (currentVulnLevel < 2) currentVulnLevel = 2; // 弱随机数
         needStartTimer = true;
     }
-    else if (output.contains("Hardened MIFARE Classic", Qt::CaseInsensitive) ||
-             output.contains("[+] Prng....... hard", Qt::CaseInsensitive)) {
+    else if (isMatched[OUTPUT_HARDENED]) {
         if (currentVulnLevel < 1) currentVulnLevel = 1; // 强化加密 (普通 M1 补丁卡)
         needStartTimer = true;
     }
@@ -461,10 +832,8 @@ void MainWindow::refreshOutput(const QString &output) {
     // ==========================================
 
     // 1. 抓取并加载密钥文件
-    QRegularExpression keyRegex("(?:saved to file|dumped to)\\s+[`']?([^`'\\n\\r]+-key(?:-[0-9]+)?\\.bin)[`']?", QRegularExpression::CaseInsensitiveOption);
-    QRegularExpressionMatch keyMatch = keyRegex.match(output);
-    if (keyMatch.hasMatch()) {
-        QString filePath = keyMatch.captured(1).trimmed();
+    if (isMatched[OUTPUT_KEY_FILE]) {
+        QString filePath = captured[OUTPUT_KEY_FILE].trimmed();
         QFileInfo fileInfo(filePath);
         QString fullPath = filePath;
 
@@ -482,15 +851,18 @@ void MainWindow::refreshOutput(const QString &output) {
             }
         }
 
-        util->delay(500);
-        mifare->data_loadKeyFile(fullPath);
+        // the keys of autopwn have been parsed from its output, only other
+        // commands need the file
+        if (mifare->data_keyRowCount() == 0) {
+            util->delay(500);
+            if (mifare->data_loadKeyFile(fullPath))
+                mifare->data_storeKeys();
+        }
     }
 
     // 2. 抓取并加载数据文件
-    QRegularExpression dumpRegex("(?:saved to file|dumped to|to binary file)\\s+[`']?([^`'\\n\\r]+-dump(?:-[0-9]+)?\\.bin)[`']?", QRegularExpression::CaseInsensitiveOption);
-    QRegularExpressionMatch dumpMatch = dumpRegex.match(output);
-    if (dumpMatch.hasMatch()) {
-        QString filePath = dumpMatch.captured(1).trimmed();
+    if (isMatched[OUTPUT_DUMP_FILE]) {
+        QString filePath = captured[OUTPUT_DUMP_FILE].trimmed();
         QFileInfo fileInfo(filePath);
         QString fullPath = filePath;
 
@@ -512,6 +884,7 @@ void MainWindow::refreshOutput(const QString &output) {
 
         if (mifare->data_loadDataFile(fullPath)) {
             mifare->data_data2Key(); // 提取密码
+            mifare->data_storeKeys();
 
             ui->funcTab->setCurrentIndex(0);
             // === 新增：由于使用了 Dock，需要 raise() 才能置顶面板 ===
@@ -533,29 +906,20 @@ void MainWindow::refreshOutput(const QString &output) {
 
     // 1. 监听 Hardnested 成功/失败特征词 (保持不变)
     // ✨ 修复：兼容旧版 found valid key 和新版 Key found: 格式
-    QRegularExpression keyRegexHN("(?:found valid key|Key found):?\\s*([0-9a-fA-F]{12})", QRegularExpression::CaseInsensitiveOption);
-    QRegularExpressionMatch keyMatchHN = keyRegexHN.match(output);
-
-    if (keyMatchHN.hasMatch()) {
+    if (isMatched[OUTPUT_HN_KEY]) {
         taskFinishType = 2;
-        foundKey = keyMatchHN.captured(1).toUpper();
-    } else if (output.contains("Hardnested attack failed", Qt::CaseInsensitive) ||
-               output.contains("not vulnerable to hardnested", Qt::CaseInsensitive)) {
+        foundKey = captured[OUTPUT_HN_KEY].toUpper();
+        mifare->data_setHardnestedKey(foundKey);
+    } else if (isMatched[OUTPUT_HN_FAILED]) {
         taskFinishType = 3;
     }
 
     // 2. 监听带有 Done! 结尾的各种命令
-    else if (output.contains("[=] Done!", Qt::CaseInsensitive) ||
-             output.contains("verify failed", Qt::CaseInsensitive)) {
-
-        QString allText = ui->Raw_outputEdit->toPlainText();
-
-        // ✨ 核心修复：找到终端里最后一次出现的命令提示符
-        int lastPromptIdx = allText.lastIndexOf("pm3 -->");
+    else if (isMatched[OUTPUT_TASK_DONE]) {
 
-        if (lastPromptIdx != -1) {
-            // 截取从最后一次敲命令到现在的文本，彻底隔离历史记录！
-            QString lastCommandBlock = allText.mid(lastPromptIdx);
+        // ✨ 核心修复：只看最后一次命令提示符之后的文本，彻底隔离历史记录！
+        if (currCMDBlock.startsWith(cmdPrompt())) {
+            const QString &lastCommandBlock = currCMDBlock;
 
             // 前提：当前必须停留在控制台界面
             if (!dockList.isEmpty() && !dockList[0]->isHidden()) {
@@ -643,9 +1007,14 @@ void MainWindow::refreshOutput(const QString &output) {
 }
 
 void MainWindow::on_stopButton_clicked() {
+    // stop the running loops of commands first, then ask the client to stop
+    // its command if enabled, and restart it if it doesn't respond
+    util->cancel();
     if (!pm3state)
         on_PM3_disconnectButton_clicked();
-    else {
+    else if (!abortOnStop || !util->abortCMD()) {
+        if (promoteStandby())
+            return;
         on_PM3_disconnectButton_clicked();
         for (int i = 0; i < 10; i++) {
             util->delay(200);
@@ -654,6 +1023,7 @@ void MainWindow::on_stopButton_clicked() {
         }
         emit reconnectPM3();
         emit setSerialListener(!keepClientActive);
+        startStandby();
     }
 }
 // *********************************************************
@@ -769,7 +1139,7 @@ void MainWindow::on_MF_keyWidget_resized(QObject *obj_addr, QEvent &event) {
 
 void MainWindow::MF_onMFCardTypeChanged(int id, bool st) {
     MFCardTypeBtnGroup->blockSignals(true);
-    qDebug() << id << MFCardTypeBtnGroup->checkedId();
+    qCDebug(lcUI) << id << MFCardTypeBtnGroup->checkedId();
     if (!st) {
         int result;
         if (id > MFCardTypeBtnGroup
@@ -785,13 +1155,13 @@ void MainWindow::MF_onMFCardTypeChanged(int id, bool st) {
             result = QMessageBox::Yes;
         }
         if (result == QMessageBox::Yes) {
-            qDebug() << "Yes";
+            qCDebug(lcUI) << "Yes";
             mifare->setCardType(MFCardTypeBtnGroup->checkedId());
             MF_widgetReset();
             mifare->data_syncWithDataWidget();
             mifare->data_syncWithKeyWidget();
         } else {
-            qDebug() << "No";
+            qCDebug(lcUI) << "No";
             MFCardTypeBtnGroup->button(id)->setChecked(true);
         }
     }
@@ -878,8 +1248,6 @@ void MainWindow::on_MF_dataWidget_itemChanged(QTableWidgetItem *item) {
              i++) {
             ui->MF_dataWidget->item(i + item->row(), 1)
             ->setCheckState(item->checkState());
-            qDebug() << i << mifare->cardType.blk[item->row()] << i + item->row()
-                     << ui->MF_dataWidget->item(i + item->row(), 1)->text();
         }
         for (int i = 0; i < mifare->cardType.sector_size; i++) {
             if (ui->MF_dataWidget->item(mifare->cardType.blks[i], 0)->checkState() ==
@@ -997,7 +1365,7 @@ void MainWindow::on_MF_File_loadButton_clicked() {
             this, title, QDir::homePath(),
             tr("Binary Data Files (*.bin *.dump)") + ";;" +
                 tr("Text Data Files (*.txt *.eml)") + ";;" + tr("All Files (*.*)"));
-        qDebug() << filename;
+        qCDebug(lcUI) << filename;
         if (filename != "") {
             if (!mifare->data_loadDataFile(filename)) {
                 QMessageBox::information(this, tr("Info"),
@@ -1010,7 +1378,7 @@ void MainWindow::on_MF_File_loadButton_clicked() {
         filename = QFileDialog::getOpenFileName(
             this, title, QDir::homePath(),
             tr("Binary Key Files (*.bin *.dump *.key)") + ";;" + tr("All Files (*.*)"));
-        qDebug() << filename;
+        qCDebug(lcUI) << filename;
         if (filename != "") {
             if (!mifare->data_loadKeyFile(filename)) {
                 QMessageBox::information(this, tr("Info"),
@@ -1037,7 +1405,7 @@ void MainWindow::on_MF_File_saveButton_clicked() {
             tr("Binary Data Files(*.bin *.dump)") + ";;" +
                 tr("Text Data Files(*.txt *.eml)"),
             &selectedType);
-        qDebug() << filename;
+        qCDebug(lcUI) << filename;
         if (filename != "") {
             if (!mifare->data_saveDataFile(
                     filename,
@@ -1051,7 +1419,7 @@ void MainWindow::on_MF_File_saveButton_clicked() {
         filename = QFileDialog::getSaveFileName(
             this, title, "./key_" + defaultName,
             tr("Binary Key Files(*.bin *.dump)"), &selectedType);
-        qDebug() << filename;
+        qCDebug(lcUI) << filename;
         if (filename != "") {
             if (!mifare->data_saveKeyFile(
                     filename, selectedType == tr("Binary Key Files(*.bin *.dump)"))) {
@@ -1060,7 +1428,7 @@ void MainWindow::on_MF_File_saveButton_clicked() {
             }
         }
     }
-    qDebug() << filename << selectedType;
+    qCDebug(lcUI) << filename << selectedType;
 }
 
 void MainWindow::on_MF_File_clearButton_clicked() {
@@ -1590,7 +1958,7 @@ void MainWindow::on_MF_Sniff_loadButton_clicked() // use a tmp file to support
         QFileDialog::getOpenFileName(this, title, clientTracePath.absolutePath(),
                                      tr("Trace Files") + "(*" + defaultExtension +
                                          ")" + ";;" + tr("All Files(*.*)"));
-    qDebug() << filename;
+    qCDebug(lcUI) << filename;
     if (filename != "") {
         QString tmpFile =
             "tmp" + QString::number(QDateTime::currentDateTimeUtc().toTime_t()) +
@@ -1627,7 +1995,7 @@ void MainWindow::on_MF_Sniff_saveButton_clicked() {
     filename = QFileDialog::getSaveFileName(
         this, title, clientTracePath.absolutePath(),
         tr("Trace Files") + "(*" + defaultExtension + ")");
-    qDebug() << filename;
+    qCDebug(lcUI) << filename;
     if (filename != "") {
         QString tmpFile =
             "tmp" + QString::number(QDateTime::currentDateTimeUtc().toTime_t()) +
@@ -1800,6 +2168,8 @@ void MainWindow::uiInit() {
     settings->beginGroup("Client_Args");
     ui->Set_Client_startArgsEdit->setText(
         settings->value("args", "<port> -f").toString());
+    ui->Set_Client_standbyArgsEdit->setText(
+        settings->value("standbyArgs", "").toString());
     settings->endGroup();
 
     settings->beginGroup("Client_forceButtonsEnabled");
@@ -1820,6 +2190,11 @@ void MainWindow::uiInit() {
     settings->endGroup();
     ui->Set_Client_keepClientActiveBox->setChecked(keepClientActive);
 
+    settings->beginGroup("Client_abortOnStop");
+    abortOnStop = settings->value("state", false).toBool();
+    settings->endGroup();
+    ui->Set_Client_abortOnStopBox->setChecked(abortOnStop);
+
     QDir configFiles(":/config/");
     configFiles.setSorting(QDir::Name);
     const QFileInfoList configFileList = configFiles.entryInfoList();
@@ -1843,6 +2218,7 @@ void MainWindow::uiInit() {
         ui->Set_Client_configFileBox->findData(settings->value("configFile"));
     ui->Set_Client_configPathEdit->setText(
         settings->value("extConfigFilePath", "config.json").toString());
+    ui->Set_Pool_portsEdit->setText(settings->value("poolPorts", "").toString());
     settings->endGroup();
     if (configId != -1)
         ui->Set_Client_configFileBox->setCurrentIndex(configId);
@@ -1850,6 +2226,29 @@ void MainWindow::uiInit() {
     on_Set_Client_configFileBox_currentIndexChanged(
         ui->Set_Client_configFileBox->currentIndex());
 
+    settings->beginGroup("Console");
+    int consoleMaxLines = settings->value("maxLines", 20000).toInt();
+    bool isConsoleLogged = settings->value("logEnabled", false).toBool();
+    ui->Set_Console_logPathEdit->setText(
+        settings->value("logPath", "console.log").toString());
+    settings->endGroup();
+    ui->Set_Console_maxLinesBox->blockSignals(true);
+    ui->Set_Console_maxLinesBox->setValue(consoleMaxLines);
+    ui->Set_Console_maxLinesBox->blockSignals(false);
+    ui->Raw_outputEdit->setMaximumBlockCount(consoleMaxLines);
+    ui->Set_Console_logBox->blockSignals(true);
+    ui->Set_Console_logBox->setChecked(isConsoleLogged);
+    ui->Set_Console_logBox->blockSignals(false);
+    setConsoleLog(isConsoleLogged);
+
+    settings->beginGroup("Solver");
+    int solverMaxRunning = settings->value("maxRunning", 1).toInt();
+    settings->endGroup();
+    ui->Set_Solver_maxRunningBox->blockSignals(true);
+    ui->Set_Solver_maxRunningBox->setValue(solverMaxRunning);
+    ui->Set_Solver_maxRunningBox->blockSignals(false);
+    solverPool->setMaxRunning(ui->Set_Solver_maxRunningBox->value());
+
     // setValue() will trigger valueChanged()
     // setValue(settings->value()) will create a nested group
     // call endGroup() before apply the value
@@ -1929,30 +2328,20 @@ void MainWindow::uiInit() {
 }
 
 void MainWindow::signalInit() {
-    connect(pm3, &PM3Process::newOutput, util, &Util::processOutput);
-    connect(pm3, &PM3Process::changeClientType, util, &Util::setClientType);
     connect(util, &Util::refreshOutput, this, &MainWindow::refreshOutput);
-
-    connect(this, &MainWindow::connectPM3, pm3, &PM3Process::connectPM3);
-    connect(this, &MainWindow::reconnectPM3, pm3, &PM3Process::reconnectPM3);
-    connect(pm3, &PM3Process::PM3StatedChanged, this,
-            &MainWindow::onPM3StateChanged);
-    connect(pm3, &PM3Process::PM3StatedChanged, util, &Util::setRunningState);
-    connect(pm3, &PM3Process::errorOccurred, this,
-            &MainWindow::onPM3ErrorOccurred);
-    connect(pm3, &PM3Process::HWConnectFailed, this,
-            &MainWindow::onPM3HWConnectFailed);
-    connect(this, &MainWindow::killPM3, pm3, &PM3Process::killPM3);
-    connect(this, &MainWindow::setProcEnv, pm3, &PM3Process::setProcEnv);
-    connect(this, &MainWindow::setWorkingDir, pm3, &PM3Process::setWorkingDir);
-    connect(this, QOverload<bool>::of(&MainWindow::setSerialListener), pm3,
-            QOverload<bool>::of(&PM3Process::setSerialListener));
-    connect(this,
-            QOverload<const QString &, bool>::of(&MainWindow::setSerialListener),
-            pm3,
-            QOverload<const QString &, bool>::of(&PM3Process::setSerialListener));
-
-    connect(util, &Util::write, pm3, &PM3Process::write);
+    // the client signals are (re)connected by attachPM3() when the standby
+    // takes over
+    attachPM3(pm3);
+
+    connect(devicePool, &DevicePool::deviceStateChanged, this,
+            &MainWindow::onPoolDeviceStateChanged);
+    connect(devicePool, &DevicePool::jobFinished, this,
+            &MainWindow::onPoolJobFinished);
+    // queued, so the client is not restarted inside Mifare::hardnested()
+    connect(mifare, &Mifare::noncesCollected, this,
+            &MainWindow::MF_onNoncesCollected, Qt::QueuedConnection);
+    connect(solverPool, &SolverPool::jobFinished, this,
+            &MainWindow::onSolverJobFinished);
 
     connect(ui->MF_typeGroupBox, &QGroupBox::clicked, this,
             &MainWindow::on_GroupBox_clicked);
@@ -2080,7 +2469,7 @@ void MainWindow::loadClientPathList() {
     int len = settings->beginReadArray("pathList");
     settings->endArray();
     if (settings->contains("path") && len == 0) {
-        qDebug() << "Using old client path storage";
+        qCInfo(lcUI) << "Using old client path storage";
         m_clientPathList += settings->value("path", "proxmark3").toString();
     } else {
         int arrayLen = settings->beginReadArray("pathList");
@@ -2102,7 +2491,7 @@ void MainWindow::loadClientPathList() {
 void MainWindow::saveClientPathList() {
     settings->beginGroup("Client_Path");
     if (settings->contains("path")) {
-        qDebug() << "Upgrading client path storage";
+        qCInfo(lcUI) << "Upgrading client path storage";
         QString oldPath = settings->value("path").toString();
         if (!oldPath.isEmpty() && !m_clientPathList.contains(oldPath))
             m_clientPathList.append(oldPath);
@@ -2131,6 +2520,12 @@ void MainWindow::on_Set_Client_startArgsEdit_editingFinished() {
     settings->endGroup();
 }
 
+void MainWindow::on_Set_Client_standbyArgsEdit_editingFinished() {
+    settings->beginGroup("Client_Args");
+    settings->setValue("standbyArgs", ui->Set_Client_standbyArgsEdit->text());
+    settings->endGroup();
+}
+
 void MainWindow::on_Set_Client_forceEnabledBox_stateChanged(int arg1) {
     settings->beginGroup("Client_forceButtonsEnabled");
     keepButtonsEnabled = (arg1 == Qt::Checked);
@@ -2175,6 +2570,13 @@ void MainWindow::on_Set_Client_keepClientActiveBox_stateChanged(int arg1) {
     emit setSerialListener(!keepClientActive);
 }
 
+void MainWindow::on_Set_Client_abortOnStopBox_stateChanged(int arg1) {
+    settings->beginGroup("Client_abortOnStop");
+    abortOnStop = (arg1 == Qt::Checked);
+    settings->setValue("state", abortOnStop);
+    settings->endGroup();
+}
+
 void MainWindow::on_LF_LFConf_freqSlider_valueChanged(int value) {
     onLFfreqConfChanged(value, true);
 }
@@ -2240,10 +2642,10 @@ void MainWindow::dockInit() {
     QDockWidget *dock;
     QWidget *widget;
     int count = ui->funcTab->count();
-    qDebug() << "dock count" << count;
+    qCDebug(lcUI) << "dock count" << count;
     for (int i = 0; i < count; i++) {
         dock = new QDockWidget(ui->funcTab->tabText(0), this);
-        qDebug() << "dock name" << ui->funcTab->tabText(0);
+        qCDebug(lcUI) << "dock name" << ui->funcTab->tabText(0);
         dock->setFeatures(
             QDockWidget::DockWidgetFloatable |
             QDockWidget::DockWidgetMovable); // movable is necessary, otherwise the
@@ -2437,7 +2839,9 @@ void MainWindow::on_MF_RW_generateEmptyDataButton_clicked() {
 void MainWindow::on_MF_RW_wipeCardButton_clicked() {
     // --- 🚨 核心防砖拦截：必须先有真实的第 0 块 ---
     QString block0Full = ui->MF_dataWidget->item(0, 2) ? ui->MF_dataWidget->item(0, 2)->text().remove(" ").toUpper() : "";
-    if (block0Full.length() != 32 || block0Full == "00000000000000000000000000000000") {
+    bool isBlock0Valid = false;
+    QByteArray block0Data = HexCodec::decode(block0Full, &isBlock0Valid);
+    if (!isBlock0Valid || block0Full.length() != 32 || block0Full == "00000000000000000000000000000000") {
         QMessageBox::critical(this, tr("危险拦截 (防变砖)"),
                               tr("当前缺少真实的第 0 块（卡号与厂商信息）！\n\n"
                                  "强制清卡前必须知道原卡的真实卡号，否则恢复数据会导致卡片报废。\n"
@@ -2451,15 +2855,15 @@ void MainWindow::on_MF_RW_wipeCardButton_clicked() {
     QByteArray emptyData;
     int blocks = mifare->cardType.block_size;
 
+    const QByteArray trailerData = HexCodec::decode("FFFFFFFFFFFFFF078069FFFFFFFFFFFF");
+    const QByteArray emptyBlockData(16, '\0');
+    emptyData.reserve(blocks * 16);
+
     for (int i = 0; i < blocks; i++) {
-        QString hexStr;
-        if (i == 0) hexStr = block0Full; // 使用刚才强制校验过的真实数据
+        if (i == 0) emptyData.append(block0Data); // 使用刚才强制校验过的真实数据
         else {
             bool isTrailer = (i < 128 && ((i + 1) % 4 == 0)) || ((i + 1) % 16 == 0);
-            hexStr = isTrailer ? "FFFFFFFFFFFFFF078069FFFFFFFFFFFF" : "00000000000000000000000000000000";
-        }
-        for(int k = 0; k < 32; k += 2) {
-            emptyData.append(static_cast<char>(hexStr.mid(k, 2).toUShort(nullptr, 16)));
+            emptyData.append(isTrailer ? trailerData : emptyBlockData);
         }
     }
 
@@ -2766,3 +3170,221 @@ void MainWindow::on_MF_File_clearAllButton_clicked()
     }
 }
 
+void MainWindow::on_MF_File_provisionButton_clicked() {
+    if (provisionDialog == nullptr)
+        provisionDialog = new MF_provisionDialog(provisioner, this);
+    provisionDialog->show();
+    provisionDialog->raise();
+}
+
+// ******************** device pool ********************
+
+void MainWindow::on_Set_Pool_connectButton_clicked() {
+    QString startArgs = ui->Set_Client_startArgsEdit->text();
+    QString clientPath = ui->PM3_pathBox->currentText();
+#if (QT_VERSION <= QT_VERSION_CHECK(5, 14, 0))
+    QStringList ports =
+        ui->Set_Pool_portsEdit->text().split(";", QString::SkipEmptyParts);
+#else
+    QStringList ports =
+        ui->Set_Pool_portsEdit->text().split(";", Qt::SkipEmptyParts);
+#endif
+
+    if (!startArgs.contains("<port>")) {
+        QMessageBox::information(
+            this, tr("Info"),
+            tr("The start arguments should contain <port> to use the device pool"));
+        return;
+    }
+
+    settings->beginGroup("Client_Env");
+    settings->setValue("poolPorts", ui->Set_Pool_portsEdit->text());
+    settings->endGroup();
+
+    on_Set_Pool_disconnectButton_clicked();
+    // resolved here as well, the main client might not be connected
+    updateClientWorkingDir();
+    devicePool->setWorkingDir(clientWorkingDir->absolutePath());
+    QString scriptPath = clientEnvScript(clientPath);
+    if (scriptPath.isEmpty()) {
+        devicePool->setProcEnv(QStringList());
+        addPoolDevices(clientPath, startArgs, ports);
+    } else if (scriptPath == envCacheScript) {
+        devicePool->setProcEnv(envCache);
+        addPoolDevices(clientPath, startArgs, ports);
+    } else {
+        resolveClientEnv(scriptPath, [=]() {
+            // an empty list makes the clients inherit the environment of the GUI
+            devicePool->setProcEnv(envCacheScript == scriptPath ? envCache
+                                                                : QStringList());
+            addPoolDevices(clientPath, startArgs, ports);
+        });
+    }
+}
+
+void MainWindow::addPoolDevices(const QString &clientPath,
+                                const QString &startArgs,
+                                const QStringList &ports) {
+    for (const QString &port : ports) {
+        int id = devicePool->addDevice(clientPath,
+                                       clientArgs(startArgs, port.trimmed()),
+                                       port.trimmed());
+        QLabel *label = new QLabel(this);
+        poolStatusBars.append(label);
+        ui->statusbar->insertPermanentWidget(id, label);
+        onPoolDeviceStateChanged(id, DevicePool::DEVICE_OFFLINE, "");
+    }
+}
+
+void MainWindow::on_Set_Pool_disconnectButton_clicked() {
+    devicePool->clearJobs();
+    devicePool->removeAll();
+    for (QLabel *label : poolStatusBars) {
+        ui->statusbar->removeWidget(label);
+        delete label;
+    }
+    poolStatusBars.clear();
+}
+
+void MainWindow::on_Set_Pool_chkButton_clicked() {
+    if (devicePool->onlineCount() == 0) {
+        QMessageBox::information(this, tr("Info"),
+                                 tr("No device in the pool is connected"));
+        return;
+    }
+    devicePool->submitToEach(mifare->chkCmd(true), mifare->chkTrigger());
+}
+
+void MainWindow::on_Set_Pool_dumpButton_clicked() {
+    if (devicePool->onlineCount() == 0) {
+        QMessageBox::information(this, tr("Info"),
+                                 tr("No device in the pool is connected"));
+        return;
+    }
+    // the dump files are named by the UID, so the devices won't overwrite each
+    // other's files in the shared working directory
+    devicePool->submitToEach(mifare->dumpCmd(), Util::ReturnTrigger(3000));
+}
+
+void MainWindow::on_Set_Pool_restoreButton_clicked() {
+    if (devicePool->onlineCount() == 0) {
+        QMessageBox::information(this, tr("Info"),
+                                 tr("No device in the pool is connected"));
+        return;
+    }
+    QString dumpFilename = QFileDialog::getOpenFileName(
+        this, tr("Plz select the data file:"), clientWorkingDir->absolutePath(),
+        tr("Binary Data Files (*.bin *.dump)") + ";;" + tr("All Files (*.*)"));
+    if (dumpFilename.isEmpty())
+        return;
+    QString keyFilename = QFileDialog::getOpenFileName(
+        this, tr("Plz select the key file:"), clientWorkingDir->absolutePath(),
+        tr("Binary Key Files (*.bin *.dump *.key)") + ";;" + tr("All Files (*.*)"));
+    devicePool->submitToEach(
+        mifare->restoreCmd(dumpFilename, keyFilename, keyFilename.isEmpty()),
+        Util::ReturnTrigger(3000));
+}
+
+void MainWindow::onPoolDeviceStateChanged(int device,
+                                          DevicePool::DeviceState state,
+                                          const QString &info) {
+    if (device >= poolStatusBars.size())
+        return;
+    QString text;
+    if (state == DevicePool::DEVICE_OFFLINE)
+        text = tr("Not Connected");
+    else if (state == DevicePool::DEVICE_IDLE)
+        text = tr("Idle");
+    else
+        text = tr("Running");
+    poolStatusBars[device]->setText(devicePool->getPort(device) + ":" + text);
+    poolStatusBars[device]->setToolTip(info);
+}
+
+void MainWindow::onPoolJobFinished(int jobId, int device, const QString &cmd,
+                                   const QString &output, bool isResultFound) {
+    Q_UNUSED(jobId);
+    Q_UNUSED(isResultFound);
+    // the outputs of the pool are shown job by job, so they don't interleave
+    // with each other
+    appendConsole("\n[" + devicePool->getPort(device) + "] " + cmd + "\n" +
+                  output);
+}
+
+// ******************** offline solver ********************
+
+void MainWindow::MF_onNoncesCollected(const QString &uid, int sector,
+                                      char keyType, const QString &file,
+                                      bool isClientSolving) {
+    if (isClientSolving)
+        // the nonces are complete, stop the brute force of the client to free
+        // the reader for the next card
+        on_stopButton_clicked();
+    if (!solverPool->isReady()) {
+        QMessageBox::information(
+            this, tr("Info"),
+            tr("The offline solver is not supported by the current config "
+               "file, the nonces are kept in %1")
+                .arg(file));
+        return;
+    }
+    int id = solverPool->submit(uid, sector, keyType, file,
+                                mifare->offlineHardnestedCmd(file));
+    if (id < 0)
+        return; // already being solved
+    appendConsole("\n" + tr("[solver] %1 sector %2 key %3 is queued(%4 running, "
+                             "%5 at most)")
+                              .arg(uid)
+                              .arg(sector)
+                              .arg(QChar(keyType))
+                              .arg(solverPool->runningCount())
+                              .arg(solverPool->maxRunning()) +
+                  "\n");
+}
+
+void MainWindow::onSolverJobFinished(int jobId, const QString &uid,
+                                     int sector, char keyType,
+                                     const QString &key,
+                                     const QString &output) {
+    Q_UNUSED(jobId);
+    QString head = tr("[solver] %1 sector %2 key %3")
+                       .arg(uid)
+                       .arg(sector)
+                       .arg(QChar(keyType));
+    appendConsole("\n" + head + "\n" + output);
+    if (key.isEmpty()) {
+        appendConsole("\n" + head + ": " + tr("failed") + "\n");
+        return;
+    }
+    appendConsole("\n" + head + ": " + key + "\n");
+    mifare->data_setSolvedKey(uid, sector, (Mifare::KeyType)keyType, key);
+}
+
+void MainWindow::on_Set_Console_maxLinesBox_valueChanged(int arg1) {
+    ui->Raw_outputEdit->setMaximumBlockCount(arg1); // 0 means unlimited
+    settings->beginGroup("Console");
+    settings->setValue("maxLines", arg1);
+    settings->endGroup();
+}
+
+void MainWindow::on_Set_Solver_maxRunningBox_valueChanged(int arg1) {
+    solverPool->setMaxRunning(arg1);
+    settings->beginGroup("Solver");
+    settings->setValue("maxRunning", arg1);
+    settings->endGroup();
+}
+
+void MainWindow::on_Set_Console_logBox_stateChanged(int arg1) {
+    setConsoleLog(arg1 == Qt::Checked);
+    settings->beginGroup("Console");
+    settings->setValue("logEnabled", ui->Set_Console_logBox->isChecked());
+    settings->endGroup();
+}
+
+void MainWindow::on_Set_Console_logPathEdit_editingFinished() {
+    settings->beginGroup("Console");
+    settings->setValue("logPath", ui->Set_Console_logPathEdit->text());
+    settings->endGroup();
+    if (consoleLog != nullptr)
+        setConsoleLog(true); // reopen at the new path
+}
@@ -7,6 +7,7 @@
 #include <QDebug>
 #include <QDesktopServices>
 #include <QDockWidget>
+#include <QFile>
 #include <QFileDialog>
 #include <QFontDialog>
 #include <QGroupBox>
@@ -26,13 +27,20 @@
 #include <QTimer>
 #include <QtSerialPort/QSerialPort>
 #include <QtSerialPort/QSerialPortInfo>
+#include <functional>
 
+#include "common/devicepool.h"
+#include "common/hexcodec.h"
 #include "common/myeventfilter.h"
+#include "common/patternset.h"
 #include "common/pm3process.h"
+#include "common/solverpool.h"
 #include "common/util.h"
 #include "module/lf.h"
 #include "module/mifare.h"
+#include "module/provisioner.h"
 #include "module/t55xxtab.h"
+#include "ui/mf_provisiondialog.h"
 #include "ui/mf_trailerdecoderdialog.h"
 
 QT_BEGIN_NAMESPACE
@@ -60,6 +68,17 @@ public slots:
   void on_MF_keyWidget_resized(QObject *obj_addr, QEvent &event);
   void onPM3ErrorOccurred(QProcess::ProcessError error);
   void onPM3HWConnectFailed();
+  void onPM3ClientLost();
+  void onStandbyStateChanged(bool isReady);
+  void onPoolDeviceStateChanged(int device, DevicePool::DeviceState state,
+                                const QString &info);
+  void onPoolJobFinished(int jobId, int device, const QString &cmd,
+                         const QString &output, bool isResultFound);
+  void MF_onNoncesCollected(const QString &uid, int sector, char keyType,
+                            const QString &file, bool isClientSolving);
+  void onSolverJobFinished(int jobId, const QString &uid, int sector,
+                           char keyType, const QString &key,
+                           const QString &output);
 private slots:
 
   void on_PM3_connectButton_clicked();
@@ -170,6 +189,8 @@ private slots:
 
   void on_Set_Client_startArgsEdit_editingFinished();
 
+  void on_Set_Client_standbyArgsEdit_editingFinished();
+
   void on_Set_Client_forceEnabledBox_stateChanged(int arg1);
 
   void on_Set_UI_setLanguageButton_clicked();
@@ -181,6 +202,7 @@ private slots:
   void on_Set_Client_envScriptEdit_editingFinished();
 
   void on_Set_Client_keepClientActiveBox_stateChanged(int arg1);
+  void on_Set_Client_abortOnStopBox_stateChanged(int arg1);
 
   void on_LF_LFConf_freqSlider_valueChanged(int value);
 
@@ -234,6 +256,26 @@ private slots:
 
   void on_MF_File_clearAllButton_clicked();
 
+  void on_MF_File_provisionButton_clicked();
+
+  void on_Set_Pool_connectButton_clicked();
+
+  void on_Set_Pool_disconnectButton_clicked();
+
+  void on_Set_Pool_chkButton_clicked();
+
+  void on_Set_Pool_dumpButton_clicked();
+
+  void on_Set_Pool_restoreButton_clicked();
+
+  void on_Set_Console_maxLinesBox_valueChanged(int arg1);
+
+  void on_Set_Console_logBox_stateChanged(int arg1);
+
+  void on_Set_Solver_maxRunningBox_valueChanged(int arg1);
+
+  void on_Set_Console_logPathEdit_editingFinished();
+
   private:
   Ui::MainWindow *ui;
   QButtonGroup *MFCardTypeBtnGroup;
@@ -258,21 +300,62 @@ private slots:
   bool pm3state;
   bool keepButtonsEnabled;
   bool keepClientActive;
+  bool abortOnStop; // the Stop button tries Util::abortCMD() before restarting
   QThread *pm3Thread;
+  // the warm-standby client, swapped with pm3 when it takes over
+  PM3Process *standby = nullptr;
+  QThread *standbyThread = nullptr;
+  bool isStandbyReady = false;
+  QString currClientPath;
+  QString currClientPort;      // "" if the start arguments have no <port>
+  QStringList currClientArgs;  // the start arguments of pm3
+  QStringList standbyArgs;     // the start arguments of standby
+  QString standbyConnectCmd;   // from the "client" part of the config file
   QTimer *portSearchTimer;
   QStringList portList;
   QStringList clientEnv;
+  // the environment script runs in the background, its result is reused by
+  // the next connection
+  QProcess *envSetProcess = nullptr;
+  QString envSetScript;  // the script envSetProcess is running
+  QList<std::function<void()>> envResolvedCallbacks;
+  QString envCacheScript;
+  QStringList envCache;
   QDir *clientWorkingDir;
 
   T55xxTab *t55xxTab;
   Mifare *mifare;
   LF *lf;
   Util *util;
+  DevicePool *devicePool;
+  SolverPool *solverPool;
+  QList<QLabel *> poolStatusBars;
+  QFile *consoleLog = nullptr; // nullptr if the raw output is not logged
+  QString currCMDBlock; // the client output since the last prompt
+  // the recognizers of refreshOutput(), from the "output" part of the config
+  // file
+  enum OutputPattern {
+    OUTPUT_MAGIC_GEN3,
+    OUTPUT_FM11RF08S,
+    OUTPUT_STATIC_NONCE,
+    OUTPUT_WEAK_PRNG,
+    OUTPUT_HARDENED,
+    OUTPUT_KEY_FILE,
+    OUTPUT_DUMP_FILE,
+    OUTPUT_HN_KEY,
+    OUTPUT_HN_FAILED,
+    OUTPUT_TASK_DONE,
+    OUTPUT_PATTERN_COUNT,
+  };
+  PatternSet outputPatterns;
+  int CMDBlockScanned = 0; // the part of currCMDBlock returned by updateCMDBlock()
 
   QList<QDockWidget *> dockList;
   QMenu *contextMenu;
 
   MF_trailerDecoderDialog *decDialog;
+  Provisioner *provisioner;
+  MF_provisionDialog *provisionDialog = nullptr;
 
   QStringList m_clientPathList;
 
@@ -285,6 +368,26 @@ private slots:
   void saveClientPathList();
   void dockInit();
   void loadConfig();
+  void appendConsole(const QString &text);
+  QString cmdPrompt();
+  void setOutputPatterns(const QVariantMap &configMap);
+  QString updateCMDBlock(const QString &output);
+  void setConsoleLog(bool st);
+  void attachPM3(PM3Process *process);
+  void detachPM3(PM3Process *process);
+  QStringList clientArgs(QString startArgs, const QString &port) const;
+  QString clientEnvScript(const QString &clientPath) const;
+  void resolveClientEnv(const QString &scriptPath,
+                        std::function<void()> onResolved);
+  void updateClientWorkingDir();
+  void addPoolDevices(const QString &clientPath, const QString &startArgs,
+                      const QStringList &ports);
+  void finishConnect(const QString &clientPath, const QStringList &args,
+                     const QString &port);
+  void startStandby();
+  void stopStandby();
+  bool promoteStandby();
+  bool isOfflineStandby() const;
 
 protected:
   void contextMenuEvent(QContextMenuEvent *event) override;
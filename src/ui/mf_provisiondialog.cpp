@@ -0,0 +1,130 @@
+﻿#include "mf_provisiondialog.h"
+#include "ui_mf_provisiondialog.h"
+
+MF_provisionDialog::MF_provisionDialog(Provisioner* provisioner, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::MF_provisionDialog)
+{
+    ui->setupUi(this);
+    this->provisioner = provisioner;
+    connect(provisioner, &Provisioner::stageChanged, this, &MF_provisionDialog::onStageChanged);
+    connect(provisioner, &Provisioner::cardFinished, this, &MF_provisionDialog::onCardFinished);
+
+    ui->recordWidget->setColumnCount(8);
+    ui->recordWidget->setHorizontalHeaderLabels({tr("Time"), tr("UID"), tr("Result"), tr("Mismatched"), tr("Wait(ms)"), tr("Write(ms)"), tr("Read(ms)"), tr("Verify(ms)")});
+    ui->recordWidget->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    ui->stopButton->setEnabled(false);
+    onStageChanged(Provisioner::STAGE_IDLE);
+}
+
+MF_provisionDialog::~MF_provisionDialog()
+{
+    delete ui;
+}
+
+void MF_provisionDialog::closeEvent(QCloseEvent *event)
+{
+    provisioner->stop();
+    QDialog::closeEvent(event);
+}
+
+void MF_provisionDialog::on_templateBrowseButton_clicked()
+{
+    QString filename = QFileDialog::getOpenFileName(this, tr("Plz select the data file:"), QDir::homePath(), tr("Binary Data Files (*.bin *.dump)") + ";;" + tr("Text Data Files (*.txt *.eml)") + ";;" + tr("All Files (*.*)"));
+    if(!filename.isEmpty())
+        ui->templateEdit->setText(filename);
+}
+
+void MF_provisionDialog::on_keyBrowseButton_clicked()
+{
+    QString filename = QFileDialog::getOpenFileName(this, tr("Plz select the key file:"), QDir::homePath(), tr("Binary Key Files (*.bin *.dump *.key)") + ";;" + tr("All Files (*.*)"));
+    if(!filename.isEmpty())
+        ui->keyEdit->setText(filename);
+}
+
+void MF_provisionDialog::on_startButton_clicked()
+{
+    ui->recordWidget->setRowCount(0);
+    ui->startButton->setEnabled(false);
+    ui->stopButton->setEnabled(true);
+    ui->templateGroupBox->setEnabled(false);
+    // returns after stop() is called
+    if(!provisioner->start(ui->templateEdit->text(), ui->keyEdit->text()))
+        QMessageBox::information(this, tr("Info"), tr("Failed to load the template dump"));
+    ui->startButton->setEnabled(true);
+    ui->stopButton->setEnabled(false);
+    ui->templateGroupBox->setEnabled(true);
+}
+
+void MF_provisionDialog::on_stopButton_clicked()
+{
+    provisioner->stop();
+}
+
+void MF_provisionDialog::on_exportButton_clicked()
+{
+    QString filename = QFileDialog::getSaveFileName(this, tr("Plz select the location to save the records:"), QDir::homePath(), tr("CSV Files (*.csv)"));
+    if(filename.isEmpty())
+        return;
+    if(!provisioner->exportCSV(filename))
+        QMessageBox::information(this, tr("Info"), tr("Failed to save to") + "\n" + filename);
+}
+
+void MF_provisionDialog::onStageChanged(Provisioner::Stage stage)
+{
+    QString text;
+    if(stage == Provisioner::STAGE_IDLE)
+        text = tr("Idle");
+    else if(stage == Provisioner::STAGE_WAIT)
+        text = tr("Waiting for a new card...");
+    else if(stage == Provisioner::STAGE_WRITE)
+        text = tr("Writing...");
+    else if(stage == Provisioner::STAGE_READ)
+        text = tr("Reading back...");
+    else if(stage == Provisioner::STAGE_VERIFY)
+        text = tr("Verifying...");
+    ui->stageLabel->setText(tr("State:") + text);
+}
+
+void MF_provisionDialog::onCardFinished(const Provisioner::Record& record)
+{
+    int row = ui->recordWidget->rowCount();
+    ui->recordWidget->setRowCount(row + 1);
+    setTableItem(row, 0, record.time.toString("hh:mm:ss"));
+    setTableItem(row, 1, record.uid);
+    setTableItem(row, 2, record.isPassed ? tr("Pass") : tr("Fail"));
+    setTableItem(row, 3, QString::number(record.mismatchedBlocks));
+    setTableItem(row, 4, QString::number(record.waitTime));
+    setTableItem(row, 5, QString::number(record.writeTime));
+    setTableItem(row, 6, QString::number(record.readTime));
+    setTableItem(row, 7, QString::number(record.verifyTime));
+    if(!record.isPassed)
+    {
+        for(int i = 0; i < ui->recordWidget->columnCount(); i++)
+            ui->recordWidget->item(row, i)->setBackground(Qt::red);
+    }
+    ui->recordWidget->scrollToBottom();
+    showStats();
+}
+
+void MF_provisionDialog::setTableItem(int row, int column, const QString& text)
+{
+    if(ui->recordWidget->item(row, column) == nullptr)
+        ui->recordWidget->setItem(row, column, new QTableWidgetItem());
+    ui->recordWidget->item(row, column)->setText(text);
+}
+
+void MF_provisionDialog::showStats()
+{
+    int passed = 0;
+    const QList<Provisioner::Record>& records = provisioner->getRecords();
+    for(const Provisioner::Record& record : records)
+    {
+        if(record.isPassed)
+            passed++;
+    }
+    Provisioner::Record average = provisioner->getAverage();
+    ui->statsLabel->setText(tr("Cards: %1, Passed: %2, %3 cards/min").arg(records.size()).arg(passed).arg(provisioner->getCardsPerMinute(), 0, 'f', 1)
+                            + "\n"
+                            + tr("Average(ms): wait %1, write %2, read %3, verify %4").arg(average.waitTime).arg(average.writeTime).arg(average.readTime).arg(average.verifyTime));
+}
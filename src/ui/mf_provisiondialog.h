@@ -0,0 +1,47 @@
+﻿#ifndef MF_PROVISIONDIALOG_H
+#define MF_PROVISIONDIALOG_H
+
+#include <QDialog>
+#include <QCloseEvent>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QTableWidget>
+#include "../module/provisioner.h"
+
+namespace Ui
+{
+class MF_provisionDialog;
+}
+
+class MF_provisionDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit MF_provisionDialog(Provisioner* provisioner, QWidget *parent = nullptr);
+    ~MF_provisionDialog();
+
+private slots:
+    void on_templateBrowseButton_clicked();
+
+    void on_keyBrowseButton_clicked();
+
+    void on_startButton_clicked();
+
+    void on_stopButton_clicked();
+
+    void on_exportButton_clicked();
+
+    void onStageChanged(Provisioner::Stage stage);
+
+    void onCardFinished(const Provisioner::Record& record);
+protected:
+    void closeEvent(QCloseEvent *event) override;
+private:
+    Ui::MF_provisionDialog *ui;
+    Provisioner* provisioner;
+    void setTableItem(int row, int column, const QString& text);
+    void showStats();
+};
+
+#endif // MF_PROVISIONDIALOG_H
@@ -0,0 +1,74 @@
+﻿#include "allocstats.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef __GLIBC__
+
+// The definitions below take the place of the ones in glibc for the whole process,
+// the real allocator is still reachable under its internal names.
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static volatile int isCounting = 0;
+static long long countedBytes = 0;
+
+static void count(size_t size)
+{
+    if(isCounting)
+        __atomic_fetch_add(&countedBytes, (long long)size, __ATOMIC_RELAXED);
+}
+
+void* malloc(size_t size)
+{
+    count(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t number, size_t size)
+{
+    count(number * size);
+    return __libc_calloc(number, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    count(size);
+    return __libc_realloc(ptr, size);
+}
+
+int allocStatsIsSupported(void)
+{
+    return 1;
+}
+
+void allocStatsStart(void)
+{
+    __atomic_store_n(&countedBytes, 0, __ATOMIC_RELAXED);
+    isCounting = 1;
+}
+
+long long allocStatsStop(void)
+{
+    isCounting = 0;
+    return __atomic_load_n(&countedBytes, __ATOMIC_RELAXED);
+}
+
+#else
+
+int allocStatsIsSupported(void)
+{
+    return 0;
+}
+
+void allocStatsStart(void)
+{
+}
+
+long long allocStatsStop(void)
+{
+    return 0;
+}
+
+#endif
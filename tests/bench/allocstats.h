@@ -0,0 +1,20 @@
+﻿#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+// Counts the bytes requested from malloc()/calloc()/realloc() by every thread of the benchmark.
+// QString, QByteArray and the containers of Qt allocate through them, so this is the heap traffic of the
+// output path. Only glibc can be hooked, allocStatsIsSupported() returns 0 elsewhere.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int allocStatsIsSupported(void);
+void allocStatsStart(void);
+long long allocStatsStop(void); // the bytes requested since allocStatsStart()
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ALLOCSTATS_H
@@ -0,0 +1,54 @@
+QT       += core gui widgets serialport testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_mifarebench
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# The benchmark drives the real Mifare/LF/Util/PM3Process code, without the main window.
+GUI_SRC = $$PWD/../../src
+INCLUDEPATH += $$GUI_SRC
+
+# The fake client and its config. Set PM3MOCK in the environment to use another build of pm3mock.
+win32: PM3MOCK_NAME = pm3mock.exe
+else: PM3MOCK_NAME = pm3mock
+DEFINES += \
+    PM3MOCK_PATH=\\\"$$OUT_PWD/../../tools/pm3mock/$$PM3MOCK_NAME\\\" \
+    BENCH_CONFIG_FILE=\\\"$$GUI_SRC/../config/config_rrgv4.20728.json\\\"
+
+SOURCES += \
+    allocstats.c \
+    tst_mifarebench.cpp \
+    $$GUI_SRC/common/hexcodec.cpp \
+    $$GUI_SRC/common/keystore.cpp \
+    $$GUI_SRC/common/log.cpp \
+    $$GUI_SRC/common/pm3process.cpp \
+    $$GUI_SRC/common/util.cpp \
+    $$GUI_SRC/module/cardimage.cpp \
+    $$GUI_SRC/module/lf.cpp \
+    $$GUI_SRC/module/mifare.cpp \
+    $$GUI_SRC/ui/mf_attack_hardnesteddialog.cpp \
+    $$GUI_SRC/ui/mf_sim_simdialog.cpp \
+    $$GUI_SRC/ui/mf_uid_parameterdialog.cpp \
+
+HEADERS += \
+    allocstats.h \
+    $$GUI_SRC/common/hexcodec.h \
+    $$GUI_SRC/common/keystore.h \
+    $$GUI_SRC/common/log.h \
+    $$GUI_SRC/common/pm3process.h \
+    $$GUI_SRC/common/util.h \
+    $$GUI_SRC/module/cardimage.h \
+    $$GUI_SRC/module/lf.h \
+    $$GUI_SRC/module/mifare.h \
+    $$GUI_SRC/ui/mf_attack_hardnesteddialog.h \
+    $$GUI_SRC/ui/mf_sim_simdialog.h \
+    $$GUI_SRC/ui/mf_uid_parameterdialog.h \
+
+FORMS += \
+    $$GUI_SRC/ui/mainwindow.ui \
+    $$GUI_SRC/ui/mf_attack_hardnesteddialog.ui \
+    $$GUI_SRC/ui/mf_sim_simdialog.ui \
+    $$GUI_SRC/ui/mf_uid_parameterdialog.ui
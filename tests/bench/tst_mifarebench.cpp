@@ -0,0 +1,430 @@
+﻿#include <QtTest>
+#include <QApplication>
+#include <QDockWidget>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMainWindow>
+#include <QThread>
+#include <algorithm>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "allocstats.h"
+#include "common/pm3process.h"
+#include "common/util.h"
+#include "module/lf.h"
+#include "module/mifare.h"
+#include "ui_mainwindow.h"
+
+// The full-card paths of the Mifare tab against pm3mock for every card layout,
+// and the single commands under them(execCMDWithOutput, _readblk, _readsec, getLFConfig) on a 1k card.
+// Run with "-iterations <n>" to collect n samples per row, the percentiles are printed after QTest's own result.
+class MifareBench : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+    void readSelected_data();
+    void readSelected();
+    void writeSelected_data();
+    void writeSelected();
+    void chk_data();
+    void chk();
+    void execCMDWithOutput_data();
+    void execCMDWithOutput();
+    void readBlock_data();
+    void readBlock();
+    void readSector_data();
+    void readSector();
+    void getLFConfig_data();
+    void getLFConfig();
+
+private:
+    QMainWindow* window = nullptr;
+    Ui::MainWindow* ui = nullptr;
+    Util* util = nullptr;
+    Mifare* mifare = nullptr; // owned by window
+    LF* lf = nullptr; // owned by window
+    QThread* pm3Thread = nullptr;
+    PM3Process* pm3 = nullptr;
+    QTimer* dialogCloser = nullptr;
+    QString mockPath;
+    QJsonObject config;
+    QString pendingLines; // the output after the last '\n', for data_parseKeyRows()
+    QElapsedTimer sampleTimer;
+    qint64 sampleCPUTime;
+    QVector<qint64> timeSamples; // ns
+    QVector<qint64> CPUSamples; // ns
+    QVector<qint64> byteSamples;
+
+    void addLayouts(bool isAllLayouts = true);
+    void resetWidgets();
+    void fillKeys();
+    void startSample();
+    void stopSample();
+    void report(const QString& operation);
+    static qint64 CPUTime();
+    static double percentile(const QVector<qint64>& sorted, double p);
+};
+
+void MifareBench::initTestCase()
+{
+    mockPath = qEnvironmentVariableIsSet("PM3MOCK") ? qEnvironmentVariable("PM3MOCK") : QString(PM3MOCK_PATH);
+    if(!QFileInfo(mockPath).isExecutable())
+        QSKIP(qPrintable("pm3mock is not found at " + mockPath + ", build tools/pm3mock or set PM3MOCK"));
+    QFile configFile(BENCH_CONFIG_FILE);
+    QVERIFY(configFile.open(QFile::ReadOnly | QFile::Text));
+    config = QJsonDocument::fromJson(configFile.readAll()).object();
+    QVERIFY(!config.isEmpty());
+
+    window = new QMainWindow;
+    ui = new Ui::MainWindow;
+    ui->setupUi(window);
+    Util::setUI(ui);
+    Util::setRawTab(new QDockWidget(window), 0);
+    util = new Util(this);
+    util->setConfigMap(config["client"].toObject().toVariantMap());
+    mifare = new Mifare(ui, util, window);
+    mifare->setConfigMap(config["mifare classic"].toObject().toVariantMap());
+    lf = new LF(ui, util, window);
+    lf->setConfigMap(config["lf"].toObject().toVariantMap());
+    connect(util, &Util::refreshOutput, this, [ = ](const QString & output)
+    {
+        // like MainWindow, the key rows are parsed line by line as they arrive
+        pendingLines += output;
+        int end = pendingLines.lastIndexOf('\n');
+        if(end == -1)
+            return;
+        mifare->data_parseKeyRows(pendingLines.left(end + 1));
+        pendingLines.remove(0, end + 1);
+    });
+
+    // nobody answers the message boxes of Mifare, take the default answer
+    dialogCloser = new QTimer(this);
+    dialogCloser->setInterval(20);
+    connect(dialogCloser, &QTimer::timeout, this, []()
+    {
+        QWidget* dialog = QApplication::activeModalWidget();
+        if(dialog != nullptr)
+            dialog->close();
+    });
+    dialogCloser->start();
+}
+
+void MifareBench::cleanupTestCase()
+{
+    delete window;
+    delete ui;
+}
+
+void MifareBench::init()
+{
+    // a new mock(a blank card) for every row
+    QFETCH(QString, card);
+    QFETCH(int, cardType);
+
+    pm3Thread = new QThread(this);
+    pm3 = new PM3Process(pm3Thread);
+    connect(pm3Thread, &QThread::finished, pm3, &PM3Process::deleteLater);
+    connect(pm3, &PM3Process::newOutput, util, &Util::processOutput);
+    connect(pm3, &PM3Process::changeClientType, util, &Util::setClientType);
+    connect(pm3, &PM3Process::PM3StatedChanged, util, &Util::setRunningState);
+    connect(util, &Util::write, pm3, &PM3Process::write);
+    pm3Thread->start();
+
+    QSignalSpy stateSpy(pm3, &PM3Process::PM3StatedChanged);
+    QMetaObject::invokeMethod(pm3, "connectPM3", Qt::QueuedConnection,
+                              Q_ARG(QString, mockPath), Q_ARG(QStringList, QStringList({"--card", card})));
+    QVERIFY(stateSpy.wait(15000));
+    QVERIFY(stateSpy.first().first().toBool());
+
+    mifare->setCardType(cardType);
+    resetWidgets();
+    mifare->data_clearData();
+    mifare->data_clearKey();
+    pendingLines.clear();
+    timeSamples.clear();
+    CPUSamples.clear();
+    byteSamples.clear();
+}
+
+void MifareBench::cleanup()
+{
+    if(pm3Thread == nullptr)
+        return;
+    QMetaObject::invokeMethod(pm3, "killPM3", Qt::BlockingQueuedConnection);
+    pm3Thread->quit();
+    pm3Thread->wait(5000);
+    delete pm3Thread;
+    pm3Thread = nullptr;
+}
+
+void MifareBench::addLayouts(bool isAllLayouts)
+{
+    QTest::addColumn<QString>("card");
+    QTest::addColumn<int>("cardType");
+
+    if(isAllLayouts)
+        QTest::newRow("mini") << "mini" << 0;
+    QTest::newRow("1k") << "1k" << 1;
+    if(isAllLayouts)
+    {
+        QTest::newRow("2k") << "2k" << 2;
+        QTest::newRow("4k") << "4k" << 4;
+    }
+}
+
+void MifareBench::resetWidgets()
+{
+    // the part of MainWindow::MF_widgetReset() the read/write paths use, every block is selected
+    int secs = mifare->cardType.sector_size;
+    int blks = mifare->cardType.block_size;
+    ui->MF_keyWidget->setRowCount(secs);
+    ui->MF_dataWidget->setRowCount(blks);
+    for(int i = 0; i < blks; i++)
+    {
+        for(int j = 0; j < 3; j++)
+            ui->MF_dataWidget->setItem(i, j, new QTableWidgetItem());
+        ui->MF_dataWidget->item(i, 1)->setText(QString::number(i));
+        ui->MF_dataWidget->item(i, 1)->setCheckState(Qt::Checked);
+    }
+    for(int i = 0; i < secs; i++)
+    {
+        for(int j = 0; j < 3; j++)
+            ui->MF_keyWidget->setItem(i, j, new QTableWidgetItem());
+        ui->MF_keyWidget->item(i, 0)->setText(QString::number(i));
+    }
+}
+
+void MifareBench::fillKeys()
+{
+    // the mock card uses FFFFFFFFFFFF for every key
+    for(int i = 0; i < mifare->cardType.sector_size; i++)
+    {
+        mifare->data_setKey(i, Mifare::KEY_A, "FFFFFFFFFFFF");
+        mifare->data_setKey(i, Mifare::KEY_B, "FFFFFFFFFFFF");
+    }
+    mifare->data_syncWithKeyWidget();
+}
+
+void MifareBench::readSelected_data()
+{
+    addLayouts();
+}
+
+void MifareBench::readSelected()
+{
+    fillKeys();
+    QBENCHMARK
+    {
+        mifare->data_clearData();
+        startSample();
+        mifare->readSelected();
+        stopSample();
+    }
+    const CardImage& image = mifare->data_getImage();
+    for(int i = 0; i < mifare->cardType.block_size; i++)
+        QVERIFY2(image.block(i).isKnown(), qPrintable(QString("block %1 is not read").arg(i)));
+    report("readSelected");
+}
+
+void MifareBench::writeSelected_data()
+{
+    addLayouts();
+}
+
+void MifareBench::writeSelected()
+{
+    // Start from what is read, so every trailer is valid and nothing asks for a confirmation,
+    // then change the data blocks, so the read back below shows every write has reached the card.
+    // Block 0 of the mock card is read-only, it keeps its data.
+    fillKeys();
+    mifare->readSelected();
+    QStringList expected;
+    for(int i = 0; i < mifare->cardType.block_size; i++)
+    {
+        bool isTrailer = (i == mifare->getTrailerBlockId(Mifare::data_b2s(i)));
+        if(i != 0 && !isTrailer)
+            mifare->data_setData(i, QString("%1").arg(i & 0xFF, 2, 16, QChar('0')).repeated(16).toUpper());
+        expected.append(mifare->data_getImage().blockText(i));
+    }
+    QBENCHMARK
+    {
+        startSample();
+        mifare->writeSelected();
+        stopSample();
+    }
+    mifare->data_clearData();
+    mifare->readSelected();
+    const CardImage& image = mifare->data_getImage();
+    for(int i = 0; i < mifare->cardType.block_size; i++)
+        QVERIFY2(image.blockText(i) == expected[i], qPrintable(QString("block %1 is not written").arg(i)));
+    report("writeSelected");
+}
+
+void MifareBench::chk_data()
+{
+    addLayouts();
+}
+
+void MifareBench::chk()
+{
+    QBENCHMARK
+    {
+        mifare->data_clearKey();
+        startSample();
+        mifare->chk();
+        stopSample();
+    }
+    const CardImage& image = mifare->data_getImage();
+    for(int i = 0; i < mifare->cardType.sector_size; i++)
+        QVERIFY2(image.key(i, Mifare::KEY_A).isKnown() && image.key(i, Mifare::KEY_B).isKnown(),
+                 qPrintable(QString("the keys of sector %1 are not found").arg(i)));
+    report("chk");
+}
+
+void MifareBench::execCMDWithOutput_data()
+{
+    addLayouts(false);
+}
+
+void MifareBench::execCMDWithOutput()
+{
+    QString result;
+    QBENCHMARK
+    {
+        startSample();
+        result = util->execCMDWithOutput("hw status");
+        stopSample();
+    }
+    QVERIFY(result.contains("divisor"));
+    report("execCMDWithOutput");
+}
+
+void MifareBench::readBlock_data()
+{
+    addLayouts(false);
+}
+
+void MifareBench::readBlock()
+{
+    QString result;
+    QBENCHMARK
+    {
+        startSample();
+        result = mifare->_readblk(1, Mifare::KEY_A, "FFFFFFFFFFFF");
+        stopSample();
+    }
+    QCOMPARE(result.length(), 32);
+    report("_readblk");
+}
+
+void MifareBench::readSector_data()
+{
+    addLayouts(false);
+}
+
+void MifareBench::readSector()
+{
+    QStringList result;
+    QBENCHMARK
+    {
+        startSample();
+        result = mifare->_readsec(1, Mifare::KEY_A, "FFFFFFFFFFFF");
+        stopSample();
+    }
+    for(const QString& block : result)
+        QCOMPARE(block.length(), 32);
+    report("_readsec");
+}
+
+void MifareBench::getLFConfig_data()
+{
+    addLayouts(false);
+}
+
+void MifareBench::getLFConfig()
+{
+    // the mock starts with the default divisor(95)
+    QBENCHMARK
+    {
+        ui->LF_LFConf_freqDivisorBox->setValue(19);
+        startSample();
+        lf->getLFConfig();
+        stopSample();
+    }
+    QCOMPARE(ui->LF_LFConf_freqDivisorBox->value(), 95);
+    report("getLFConfig");
+}
+
+void MifareBench::startSample()
+{
+    allocStatsStart();
+    sampleCPUTime = CPUTime();
+    sampleTimer.start();
+}
+
+void MifareBench::stopSample()
+{
+    timeSamples.append(sampleTimer.nsecsElapsed());
+    CPUSamples.append(CPUTime() - sampleCPUTime);
+    byteSamples.append(allocStatsStop());
+}
+
+qint64 MifareBench::CPUTime()
+{
+    // user + system time of every thread of the benchmark(not the mock) in ns, 0 if unsupported
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (static_cast<qint64>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+            + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000;
+#else
+    return 0;
+#endif
+}
+
+double MifareBench::percentile(const QVector<qint64>& sorted, double p)
+{
+    // nearest-rank
+    int rank = qMax(1, static_cast<int>(p * sorted.size() + 0.999999));
+    return sorted[qMin(rank, sorted.size()) - 1];
+}
+
+void MifareBench::report(const QString& operation)
+{
+    if(timeSamples.isEmpty())
+        return;
+    QVector<qint64> times = timeSamples;
+    QVector<qint64> CPUTimes = CPUSamples;
+    QVector<qint64> bytes = byteSamples;
+    std::sort(times.begin(), times.end());
+    std::sort(CPUTimes.begin(), CPUTimes.end());
+    std::sort(bytes.begin(), bytes.end());
+    QString text = QString("%1(%2): %3 samples, p50 %4 ms, p99 %5 ms")
+                   .arg(operation)
+                   .arg(QTest::currentDataTag())
+                   .arg(times.size())
+                   .arg(percentile(times, 0.5) / 1e6, 0, 'f', 2)
+                   .arg(percentile(times, 0.99) / 1e6, 0, 'f', 2);
+#ifdef Q_OS_UNIX
+    text += QString(", CPU p50 %1 ms, p99 %2 ms")
+            .arg(percentile(CPUTimes, 0.5) / 1e6, 0, 'f', 2)
+            .arg(percentile(CPUTimes, 0.99) / 1e6, 0, 'f', 2);
+#endif
+    if(allocStatsIsSupported())
+        text += QString(", heap p50 %1 bytes, p99 %2 bytes")
+                .arg(static_cast<qint64>(percentile(bytes, 0.5)))
+                .arg(static_cast<qint64>(percentile(bytes, 0.99)));
+    qInfo().noquote() << text;
+}
+
+QTEST_MAIN(MifareBench)
+
+#include "tst_mifarebench.moc"
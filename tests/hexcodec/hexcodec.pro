@@ -0,0 +1,19 @@
+QT       -= gui
+QT       += core testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_hexcodec
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+GUI_SRC = $$PWD/../../src
+INCLUDEPATH += $$GUI_SRC
+
+SOURCES += \
+    tst_hexcodec.cpp \
+    $$GUI_SRC/common/hexcodec.cpp \
+
+HEADERS += \
+    $$GUI_SRC/common/hexcodec.h \
@@ -0,0 +1,190 @@
+﻿#include <QtTest>
+
+#include "common/hexcodec.h"
+
+// HexCodec against a plain scalar reference. Where SSE2 is available, the first (length / 8 * 8) bytes go through
+// the SSE2 kernels and the rest through the scalar tail, so lengths 0-33 cover both paths and every lane of them.
+class HexCodecTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void encode_data();
+    void encode();
+    void decode_data();
+    void decode();
+    void decodeOddLength();
+    void decodeInvalidChar_data();
+    void decodeInvalidChar();
+    void decodeEveryChar();
+
+private:
+    static const int maxLength = 33;
+    static QByteArray testBytes(int length);
+    static QString refEncode(const QByteArray& data);
+    static int refHexValue(QChar ch);
+    static bool refDecode(const QString& text, QByteArray* out);
+    static void addLengths();
+};
+
+QByteArray HexCodecTest::testBytes(int length)
+{
+    // covers every nibble value in every lane
+    QByteArray result;
+    for(int i = 0; i < length; i++)
+        result.append(static_cast<char>((i * 37 + 11) & 0xFF));
+    return result;
+}
+
+QString HexCodecTest::refEncode(const QByteArray& data)
+{
+    const char digits[] = "0123456789ABCDEF";
+    QString result;
+    for(char ch : data)
+    {
+        quint8 byte = static_cast<quint8>(ch);
+        result.append(QChar(digits[byte >> 4]));
+        result.append(QChar(digits[byte & 0x0F]));
+    }
+    return result;
+}
+
+int HexCodecTest::refHexValue(QChar ch)
+{
+    ushort c = ch.unicode();
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+bool HexCodecTest::refDecode(const QString& text, QByteArray* out)
+{
+    out->clear();
+    if(text.size() % 2 != 0)
+        return false;
+    for(int i = 0; i < text.size(); i += 2)
+    {
+        int high = refHexValue(text[i]);
+        int low = refHexValue(text[i + 1]);
+        if(high < 0 || low < 0)
+        {
+            out->clear();
+            return false;
+        }
+        out->append(static_cast<char>((high << 4) | low));
+    }
+    return true;
+}
+
+void HexCodecTest::addLengths()
+{
+    QTest::addColumn<int>("length");
+    for(int i = 0; i <= maxLength; i++)
+        QTest::newRow(qPrintable(QString("%1 bytes").arg(i))) << i;
+}
+
+void HexCodecTest::encode_data()
+{
+    addLengths();
+}
+
+void HexCodecTest::encode()
+{
+    QFETCH(int, length);
+    QByteArray data = testBytes(length);
+    QCOMPARE(HexCodec::encode(data), refEncode(data));
+    // every byte value, starting at every lane
+    QByteArray allBytes;
+    for(int i = 0; i < 256 + length; i++)
+        allBytes.append(static_cast<char>(i & 0xFF));
+    allBytes = allBytes.mid(length);
+    QCOMPARE(HexCodec::encode(allBytes), refEncode(allBytes));
+}
+
+void HexCodecTest::decode_data()
+{
+    addLengths();
+}
+
+void HexCodecTest::decode()
+{
+    QFETCH(int, length);
+    QByteArray data = testBytes(length);
+    QString upper = refEncode(data);
+    QString lower = upper.toLower();
+    QString mixed = upper;
+    for(int i = 0; i < mixed.size(); i += 2)
+        mixed[i] = mixed[i].toLower();
+    for(const QString& text : {upper, lower, mixed})
+    {
+        bool isOk = false;
+        QCOMPARE(HexCodec::decode(text, &isOk), data);
+        QVERIFY(isOk);
+    }
+}
+
+void HexCodecTest::decodeOddLength()
+{
+    QString text = refEncode(testBytes(maxLength)) + "0";
+    for(int i = 1; i <= text.size(); i += 2)
+    {
+        bool isOk = true;
+        QCOMPARE(HexCodec::decode(text.left(i), &isOk), QByteArray());
+        QVERIFY(!isOk);
+    }
+}
+
+void HexCodecTest::decodeInvalidChar_data()
+{
+    // the neighbours of the hex digit ranges, the bytes the signed comparisons might let through,
+    // and characters above Latin-1 whose low byte is a hex digit
+    QTest::addColumn<QChar>("ch");
+    const ushort chars[] = {'/', ':', '@', 'G', '`', 'g', ' ', '?', 'x',
+                            0x00, 0x7F, 0x80, 0xB0, 0xC1, 0xE1, 0xFF,
+                            0x0130, 0x0141, 0x0161, 0x3030, 0x8030, 0xFF10, 0xFF21, 0xFF41, 0xFFFF
+                           };
+    for(ushort c : chars)
+        QTest::newRow(qPrintable(QString("U+%1").arg(c, 4, 16, QChar('0')))) << QChar(c);
+}
+
+void HexCodecTest::decodeInvalidChar()
+{
+    QFETCH(QChar, ch);
+    QString valid = refEncode(testBytes(maxLength));
+    for(int i = 0; i < valid.size(); i++)
+    {
+        QString text = valid;
+        text[i] = ch;
+        bool isOk = true;
+        QByteArray result = HexCodec::decode(text, &isOk);
+        QVERIFY2(!isOk && result.isEmpty(), qPrintable(QString("accepted at position %1").arg(i)));
+    }
+}
+
+void HexCodecTest::decodeEveryChar()
+{
+    // every UTF-16 code unit at the first and the last lane of an SSE2 block and in the scalar tail
+    const QString valid = refEncode(testBytes(maxLength));
+    const int positions[] = {0, 15, 31, 63, 64, 65};
+    for(int pos : positions)
+    {
+        for(int c = 0; c <= 0xFFFF; c++)
+        {
+            QString text = valid;
+            text[pos] = QChar(static_cast<ushort>(c));
+            QByteArray expected, result;
+            bool isExpectedOk = refDecode(text, &expected);
+            bool isOk = false;
+            result = HexCodec::decode(text, &isOk);
+            if(isOk != isExpectedOk || result != expected)
+                QFAIL(qPrintable(QString("U+%1 at position %2").arg(c, 4, 16, QChar('0')).arg(pos)));
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(HexCodecTest)
+
+#include "tst_hexcodec.moc"
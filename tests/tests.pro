@@ -0,0 +1,10 @@
+TEMPLATE = subdirs
+
+# The benchmarks run the GUI code against tools/pm3mock, build it first.
+SUBDIRS += \
+    hexcodec \
+    pm3mock \
+    bench \
+
+pm3mock.file = ../tools/pm3mock/pm3mock.pro
+bench.depends = pm3mock
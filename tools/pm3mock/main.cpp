@@ -0,0 +1,16 @@
+﻿#include "mockclient.h"
+
+#include <QCoreApplication>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    MockClient client;
+    if(!client.parseArgs(a.arguments().mid(1)))
+    {
+        QTextStream(stderr) << "usage: pm3mock [port] [--card mini|1k|2k|4k] [--image <dump file>]\n"
+                               "               [--latency <ms>] [--latency-cmd \"<command prefix>=<ms>\"]...\n";
+        return 1;
+    }
+    return client.run();
+}
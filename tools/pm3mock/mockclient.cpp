@@ -0,0 +1,632 @@
+﻿#include "mockclient.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutexLocker>
+
+#include <cctype>
+
+void InputReader::run()
+{
+    QTextStream in(stdin);
+    QString line;
+    while(in.readLineInto(&line))
+    {
+        QMutexLocker locker(&mutex);
+        lines.append(line);
+        lineAdded.wakeAll();
+    }
+    QMutexLocker locker(&mutex);
+    isEnd = true;
+    lineAdded.wakeAll();
+}
+
+bool InputReader::readLine(QString* line)
+{
+    QMutexLocker locker(&mutex);
+    while(lines.isEmpty() && !isEnd)
+        lineAdded.wait(&mutex);
+    if(lines.isEmpty())
+        return false;
+    *line = lines.takeFirst();
+    return true;
+}
+
+bool InputReader::waitForLine(int msec)
+{
+    // kbd_enter_pressed() of the real client reads all the available input, so the lines after Enter are lost too
+    QMutexLocker locker(&mutex);
+    QElapsedTimer timer;
+    timer.start();
+    while(lines.isEmpty() && !isEnd && timer.elapsed() < msec)
+        lineAdded.wait(&mutex, static_cast<unsigned long>(msec - timer.elapsed()));
+    if(lines.isEmpty())
+        return false;
+    lines.clear();
+    return true;
+}
+
+MockClient::MockClient() : out(stdout)
+{
+    input = nullptr;
+    prompt = "[usb] pm3 --> ";
+    defaultLatency = 0;
+    dictionary = QStringList({"FFFFFFFFFFFF", "000000000000", "A0A1A2A3A4A5", "B0B1B2B3B4B5",
+                              "D3F7D3F7D3F7", "AABBCCDDEEFF", "4D3A99C351DD", "1A982C7E459A"});
+    divisor = 95;
+    bitsPerSample = 8;
+    decimation = 1;
+    averaging = true;
+    triggerThreshold = 0;
+    samplesToSkip = 0;
+    resetCard(64);
+
+    handlers.append(qMakePair(QString("rem"), &MockClient::remark));
+    handlers.append(qMakePair(QString("hw version"), &MockClient::hwVersion));
+    handlers.append(qMakePair(QString("hw status"), &MockClient::hwStatus));
+    handlers.append(qMakePair(QString("hw setlfdivisor"), &MockClient::hwSetLFDivisor));
+    handlers.append(qMakePair(QString("lf config"), &MockClient::lfConfig));
+    handlers.append(qMakePair(QString("hf 14a info"), &MockClient::hf14aInfo));
+    handlers.append(qMakePair(QString("hf mf info"), &MockClient::hf14aInfo));
+    handlers.append(qMakePair(QString("hf mf rdbl"), &MockClient::hfMfReadBlock));
+    handlers.append(qMakePair(QString("hf mf rdsc"), &MockClient::hfMfReadSector));
+    handlers.append(qMakePair(QString("hf mf wrbl"), &MockClient::hfMfWriteBlock));
+    handlers.append(qMakePair(QString("hf mf chk"), &MockClient::hfMfCheck));
+    handlers.append(qMakePair(QString("hf mf nested"), &MockClient::hfMfNested));
+    handlers.append(qMakePair(QString("hf mf staticnested"), &MockClient::hfMfNested));
+    handlers.append(qMakePair(QString("hf mf dump"), &MockClient::hfMfDump));
+    handlers.append(qMakePair(QString("hf mf restore"), &MockClient::hfMfRestore));
+    handlers.append(qMakePair(QString("hf mf cgetblk"), &MockClient::hfMfMagicRead));
+    handlers.append(qMakePair(QString("hf mf cgetsc"), &MockClient::hfMfMagicRead));
+    handlers.append(qMakePair(QString("hf mf csetblk"), &MockClient::hfMfMagicWrite));
+    handlers.append(qMakePair(QString("hf mf egetblk"), &MockClient::hfMfEmulatorRead));
+    handlers.append(qMakePair(QString("hf mf esetblk"), &MockClient::hfMfEmulatorWrite));
+    handlers.append(qMakePair(QString("hf mf eclr"), &MockClient::hfMfEmulatorClear));
+
+    abortableHandlers.append(&MockClient::hfMfCheck);
+    abortableHandlers.append(&MockClient::hfMfNested);
+}
+
+bool MockClient::parseArgs(const QStringList& args)
+{
+    // The arguments of the real client(port, -p <port>, -f...) are accepted and ignored,
+    // so the mock can be selected as the client path in the GUI without other changes.
+    QString imageFile;
+    int blockCount = 0;
+    for(int i = 0; i < args.size(); i++)
+    {
+        const QString& arg = args[i];
+        bool isOk = true;
+        if(arg == "--image" && i + 1 < args.size())
+            imageFile = args[++i];
+        else if(arg == "--card" && i + 1 < args.size())
+        {
+            QString type = args[++i];
+            if(type == "mini")
+                blockCount = 20;
+            else if(type == "1k")
+                blockCount = 64;
+            else if(type == "2k")
+                blockCount = 128;
+            else if(type == "4k")
+                blockCount = 256;
+            else
+                return false;
+        }
+        else if(arg == "--latency" && i + 1 < args.size())
+            defaultLatency = args[++i].toInt(&isOk);
+        else if(arg == "--latency-cmd" && i + 1 < args.size())
+        {
+            // "hf mf chk=2000"
+            QString item = args[++i];
+            int pos = item.lastIndexOf('=');
+            if(pos <= 0)
+                return false;
+            latencies.append(qMakePair(item.left(pos).trimmed(), item.mid(pos + 1).toInt(&isOk)));
+        }
+        else if(arg == "-p" && i + 1 < args.size())
+            port = args[++i];
+        else if(!arg.startsWith("-") && port.isEmpty())
+            port = arg;
+        if(!isOk)
+            return false;
+    }
+    if(blockCount != 0)
+        resetCard(blockCount);
+    if(!imageFile.isEmpty() && !loadImage(imageFile))
+        return false;
+    return true;
+}
+
+int MockClient::run()
+{
+    // never deleted, it's blocked in reading stdin until the process exits
+    input = new InputReader;
+    input->start();
+    QString line;
+
+    out << "[=] Session log mock\n";
+    out << "[+] loaded from mock client settings\n";
+    out << "[=] Using UART port " << (port.isEmpty() ? "/dev/ttyACM0" : port) << "\n";
+    out << "[=] Communicating with PM3 over USB-CDC\n";
+    out.flush();
+
+    while(input->readLine(&line))
+    {
+        line = line.trimmed();
+        // the real client skips empty lines, and echoes the other ones read from a pipe after the prompt
+        if(line.isEmpty())
+            continue;
+        out << prompt << line << "\n";
+        out.flush();
+        if(line == "quit" || line == "exit" || line == "q")
+            break;
+        execute(line);
+        out.flush();
+    }
+    return 0;
+}
+
+void MockClient::resetCard(int blockCount)
+{
+    // UID 11223344, default keys and access bits
+    blocks.fill(QByteArray(16, '\0'), blockCount);
+    emulator.fill(QByteArray(16, '\0'), blockCount);
+    blocks[0] = QByteArray::fromHex("11223344440804006263646566676869");
+    for(int i = 0; i < sectorCount(); i++)
+        blocks[firstBlockOf(i) + blockCountOf(i) - 1] = QByteArray::fromHex("FFFFFFFFFFFFFF078069FFFFFFFFFFFF");
+    uid = blocks[0].left(4);
+}
+
+bool MockClient::loadImage(const QString& filename)
+{
+    // .bin/.dump(raw bytes) or .eml(one block per line), the card size follows the file
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    QByteArray buff = file.readAll();
+    file.close();
+
+    bool isText = true;
+    for(char ch : buff)
+    {
+        if(!(isxdigit(static_cast<unsigned char>(ch)) || ch == '\n' || ch == '\r'))
+        {
+            isText = false;
+            break;
+        }
+    }
+    QVector<QByteArray> data;
+    if(isText)
+    {
+        for(const QByteArray& line : buff.split('\n'))
+        {
+            QByteArray block = QByteArray::fromHex(line.trimmed());
+            if(block.size() == 16)
+                data.append(block);
+        }
+    }
+    else
+    {
+        for(int i = 0; i + 16 <= buff.size(); i += 16)
+            data.append(buff.mid(i, 16));
+    }
+    if(data.size() != 20 && data.size() != 64 && data.size() != 128 && data.size() != 256)
+        return false;
+    resetCard(data.size());
+    blocks = data;
+    uid = blocks[0].left(4);
+    return true;
+}
+
+int MockClient::latencyOf(const QString& cmd) const
+{
+    int result = defaultLatency;
+    int matchedLength = -1;
+    for(const QPair<QString, int>& item : latencies)
+    {
+        if(cmd.startsWith(item.first) && item.first.length() > matchedLength)
+        {
+            matchedLength = item.first.length();
+            result = item.second;
+        }
+    }
+    return result;
+}
+
+void MockClient::execute(const QString& line)
+{
+#if (QT_VERSION <= QT_VERSION_CHECK(5,14,0))
+    QStringList args = line.split(' ', QString::SkipEmptyParts);
+#else
+    QStringList args = line.split(' ', Qt::SkipEmptyParts);
+#endif
+    int latency = latencyOf(line);
+    for(const QPair<QString, Handler>& handler : handlers)
+    {
+        if(line == handler.first || line.startsWith(handler.first + " "))
+        {
+            if(!abortableHandlers.contains(handler.second))
+                QThread::msleep(latency);
+            else if(latency > 0 && input->waitForLine(latency))
+            {
+                out << "[!] aborted via keyboard!\n";
+                return;
+            }
+            (this->*handler.second)(args);
+            return;
+        }
+    }
+    QThread::msleep(latency);
+    out << "[!] '" << line << "' is not supported by the mock client\n";
+}
+
+int MockClient::sectorCount() const
+{
+    return blocks.size() <= 128 ? blocks.size() / 4 : 32 + (blocks.size() - 128) / 16;
+}
+
+int MockClient::sectorOf(int block) const
+{
+    return block < 128 ? block / 4 : 32 + (block - 128) / 16;
+}
+
+int MockClient::firstBlockOf(int sector) const
+{
+    return sector < 32 ? sector * 4 : 128 + (sector - 32) * 16;
+}
+
+int MockClient::blockCountOf(int sector) const
+{
+    return sector < 32 ? 4 : 16;
+}
+
+bool MockClient::isTrailer(int block) const
+{
+    int sector = sectorOf(block);
+    return block == firstBlockOf(sector) + blockCountOf(sector) - 1;
+}
+
+bool MockClient::auth(int block, const QStringList& args)
+{
+    int sector = sectorOf(block);
+    const QByteArray& trailer = blocks[firstBlockOf(sector) + blockCountOf(sector) - 1];
+    QByteArray key = QByteArray::fromHex(option(args, "-k").toLatin1());
+    QByteArray expected = args.contains("-b") ? trailer.mid(10, 6) : trailer.left(6);
+    if(key.size() == 6 && key == expected)
+        return true;
+    out << "[#] Auth error\n";
+    return false;
+}
+
+QString MockClient::blockLine(int block, const QByteArray& data, bool hideKeys) const
+{
+    // KeyA is never readable, a real card returns zeros instead
+    QByteArray shown = data;
+    if(hideKeys && isTrailer(block))
+        shown.replace(0, 6, QByteArray(6, '\0'));
+    QString ascii;
+    for(char ch : shown)
+        ascii += (ch >= 0x20 && ch < 0x7F) ? QChar(ch) : QChar('.');
+    return QString("[=] %1 | %2 | %3\n").arg(block, 3).arg(toHex(shown, " ")).arg(ascii);
+}
+
+void MockClient::printKeyTable(bool allKeys)
+{
+    out << "[+] -----+-----+--------------+---+--------------+----\n";
+    out << "[+]  Sec | Blk | key A        |res| key B        |res\n";
+    out << "[+] -----+-----+--------------+---+--------------+----\n";
+    for(int i = 0; i < sectorCount(); i++)
+    {
+        int trailerId = firstBlockOf(i) + blockCountOf(i) - 1;
+        QString keyA = toHex(blocks[trailerId].left(6));
+        QString keyB = toHex(blocks[trailerId].mid(10, 6));
+        bool isAFound = allKeys || dictionary.contains(keyA);
+        bool isBFound = allKeys || dictionary.contains(keyB);
+        out << QString("[+]  %1 | %2 | %3 | %4 | %5 | %6\n")
+            .arg(i, 3, 10, QChar('0'))
+            .arg(trailerId, 3, 10, QChar('0'))
+            .arg(isAFound ? keyA : "------------")
+            .arg(isAFound ? 1 : 0)
+            .arg(isBFound ? keyB : "------------")
+            .arg(isBFound ? 1 : 0);
+    }
+    out << "[+] -----+-----+--------------+---+--------------+----\n";
+    out << "[+] ( 0:Failed / 1:Success )\n";
+}
+
+QString MockClient::option(const QStringList& args, const QString& name)
+{
+    int i = args.indexOf(name);
+    return (i != -1 && i + 1 < args.size()) ? args[i + 1] : QString();
+}
+
+QString MockClient::toHex(const QByteArray& data, const QString& separator)
+{
+    QStringList result;
+    for(char ch : data)
+        result.append(QString("%1").arg(static_cast<quint8>(ch), 2, 16, QChar('0')).toUpper());
+    return result.join(separator);
+}
+
+void MockClient::remark(const QStringList& args)
+{
+    // does nothing like the real one, the GUI uses it as the sentinel after a batch of commands
+    out << "[+] " << QDateTime::currentDateTime().toString(Qt::ISODate) << " remark: " << args.mid(1).join(' ') << "\n";
+}
+
+void MockClient::hwVersion(const QStringList& args)
+{
+    Q_UNUSED(args)
+    out << "\n [ Proxmark3 RFID instrument ]\n\n";
+    out << " [ Client ]\n";
+    out << "  Iceman/master/v4.20728-mock\n";
+    out << " [ ARM ]\n";
+    out << "  Bootrom.... Iceman/master/v4.20728-mock\n";
+    out << "  OS......... Iceman/master/v4.20728-mock\n";
+}
+
+void MockClient::hwStatus(const QStringList& args)
+{
+    Q_UNUSED(args)
+    out << "[#] Memory\n";
+    out << "[#]   BigBuf_size............. 40000\n";
+    out << "[#]  LF Sampling config\n";
+    out << "[#]   [q] divisor.............. " << divisor
+        << QString(" ( %1 kHz )\n").arg(12000.0 / (divisor + 1), 0, 'f', 2);
+    out << "[#]   [b] bits per sample...... " << bitsPerSample << "\n";
+    out << "[#]   [d] decimation........... " << decimation << "\n";
+    out << "[#]   [a] averaging............ " << (averaging ? "yes" : "no") << "\n";
+    out << "[#]   [t] trigger threshold.... " << triggerThreshold << "\n";
+    out << "[#]   [s] samples to skip...... " << samplesToSkip << "\n";
+    out << "[#] LF Sampling Stack\n";
+    out << "[#]   Max stack usage......... 0 / 8480 bytes\n";
+}
+
+void MockClient::hwSetLFDivisor(const QStringList& args)
+{
+    bool isOk;
+    int value = option(args, "-d").toInt(&isOk);
+    if(!isOk || value < 19 || value > 255)
+    {
+        out << "[-] divisor must be between 19 and 255\n";
+        return;
+    }
+    divisor = value;
+    out << QString("[+] Divisor set, expected %1 kHz\n").arg(12000.0 / (divisor + 1), 0, 'f', 2);
+}
+
+void MockClient::lfConfig(const QStringList& args)
+{
+    if(!option(args, "--divisor").isEmpty())
+        divisor = option(args, "--divisor").toInt();
+    if(!option(args, "--bps").isEmpty())
+        bitsPerSample = option(args, "--bps").toInt();
+    if(!option(args, "--dec").isEmpty())
+        decimation = option(args, "--dec").toInt();
+    if(!option(args, "--avg").isEmpty())
+        averaging = option(args, "--avg").toInt() != 0;
+    if(!option(args, "--trig").isEmpty())
+        triggerThreshold = option(args, "--trig").toInt();
+    if(!option(args, "--skip").isEmpty())
+        samplesToSkip = option(args, "--skip").toInt();
+    hwStatus(args);
+}
+
+void MockClient::hf14aInfo(const QStringList& args)
+{
+    Q_UNUSED(args)
+    QString atqa = blocks.size() == 256 ? "00 02" : "00 04";
+    QString sak = blocks.size() == 256 ? "18 [2]" : (blocks.size() == 20 ? "09 [2]" : "08 [2]");
+    out << "\n[=] --- ISO14443-a Information ---------------------\n";
+    out << "[+]  UID: " << toHex(uid, " ") << "\n";
+    out << "[+] ATQA: " << atqa << "\n";
+    out << "[+]  SAK: " << sak << "\n";
+    out << "[+] Possible types:\n";
+    out << "[+]    MIFARE Classic " << (blocks.size() == 20 ? "Mini" : QString("%1K").arg(blocks.size() / 64)) << "\n";
+}
+
+void MockClient::hfMfReadBlock(const QStringList& args)
+{
+    bool isOk;
+    int block = option(args, "--blk").toInt(&isOk);
+    if(!isOk || block < 0 || block >= blocks.size())
+    {
+        out << "[-] block number is invalid\n";
+        return;
+    }
+    if(!auth(block, args))
+    {
+        out << "[-] Read block error\n";
+        return;
+    }
+    out << "\n[=]   # | sector " << QString::number(sectorOf(block)).rightJustified(2, '0') << "\n";
+    out << "[=] ----+-------------------------------------------------+-----------------\n";
+    out << blockLine(block, blocks[block], true);
+}
+
+void MockClient::hfMfReadSector(const QStringList& args)
+{
+    bool isOk;
+    int sector = option(args, "--sec").toInt(&isOk);
+    if(!isOk || sector < 0 || sector >= sectorCount())
+    {
+        out << "[-] sector number is invalid\n";
+        return;
+    }
+    if(!auth(firstBlockOf(sector), args))
+    {
+        out << "[-] Read sector " << sector << " error\n";
+        return;
+    }
+    out << "\n[=]   # | sector " << QString::number(sector).rightJustified(2, '0') << "\n";
+    out << "[=] ----+-------------------------------------------------+-----------------\n";
+    for(int i = firstBlockOf(sector); i < firstBlockOf(sector) + blockCountOf(sector); i++)
+        out << blockLine(i, blocks[i], true);
+}
+
+void MockClient::hfMfWriteBlock(const QStringList& args)
+{
+    bool isOk;
+    int block = option(args, "--blk").toInt(&isOk);
+    QByteArray data = QByteArray::fromHex(option(args, "-d").toLatin1());
+    if(!isOk || block < 0 || block >= blocks.size() || data.size() != 16)
+    {
+        out << "[-] Write ( fail ), invalid parameter\n";
+        return;
+    }
+    // block 0 of a normal card is read-only
+    if(block == 0 || !auth(block, args))
+    {
+        out << "[-] Write ( fail )\n";
+        return;
+    }
+    blocks[block] = data;
+    out << "[+] Write ( ok )\n";
+}
+
+void MockClient::hfMfCheck(const QStringList& args)
+{
+    Q_UNUSED(args)
+    out << "[=] Start check for keys...\n";
+    printKeyTable(false);
+}
+
+void MockClient::hfMfNested(const QStringList& args)
+{
+    // every key is recovered from a known one
+    bool isOk;
+    int block = option(args, "--blk").toInt(&isOk);
+    if(!isOk || block < 0 || block >= blocks.size())
+    {
+        out << "[-] block number is invalid\n";
+        return;
+    }
+    if(!auth(block, args))
+    {
+        out << "[-] Wrong key. Can't authenticate to block " << block << "\n";
+        return;
+    }
+    out << "[+] Testing known keys. Sector count " << sectorCount() << "\n";
+    printKeyTable(true);
+}
+
+void MockClient::hfMfDump(const QStringList& args)
+{
+    Q_UNUSED(args)
+    QString filename = "hf-mf-" + toHex(uid) + "-dump.bin";
+    QFile file(filename);
+    QByteArray buff;
+    for(const QByteArray& block : blocks)
+        buff += block;
+    if(!file.open(QIODevice::WriteOnly) || file.write(buff) != buff.size())
+    {
+        out << "[-] Failed to save file " << filename << "\n";
+        return;
+    }
+    file.close();
+    out << "[+] Succeeded in dumping all blocks\n";
+    out << "[+] saved " << buff.size() << " bytes to binary file `" << filename << "`\n";
+}
+
+void MockClient::hfMfRestore(const QStringList& args)
+{
+    QString filename = option(args, "-f");
+    if(filename.isEmpty())
+        filename = option(args, "--file");
+    if(filename.isEmpty())
+        filename = "hf-mf-" + toHex(uid) + "-dump.bin";
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        out << "[-] File: " << filename << ": not found or locked.\n";
+        return;
+    }
+    QByteArray buff = file.readAll();
+    file.close();
+    if(buff.size() < blocks.size() * 16)
+    {
+        out << "[-] File reading error.\n";
+        return;
+    }
+    out << "[=] Restoring " << filename << " to card\n";
+    for(int i = 1; i < blocks.size(); i++)
+    {
+        blocks[i] = buff.mid(i * 16, 16);
+        out << "[=] block " << QString::number(i).rightJustified(3) << ": " << toHex(blocks[i], " ") << "\n";
+    }
+    out << "[=] Done!\n";
+}
+
+void MockClient::hfMfMagicRead(const QStringList& args)
+{
+    // a magic card answers without authentication
+    bool isOk;
+    if(args.contains("--sec"))
+    {
+        int sector = option(args, "--sec").toInt(&isOk);
+        if(!isOk || sector < 0 || sector >= sectorCount())
+        {
+            out << "[-] sector number is invalid\n";
+            return;
+        }
+        for(int i = firstBlockOf(sector); i < firstBlockOf(sector) + blockCountOf(sector); i++)
+            out << blockLine(i, blocks[i], false);
+        return;
+    }
+    int block = option(args, "--blk").toInt(&isOk);
+    if(!isOk || block < 0 || block >= blocks.size())
+    {
+        out << "[-] block number is invalid\n";
+        return;
+    }
+    out << blockLine(block, blocks[block], false);
+}
+
+void MockClient::hfMfMagicWrite(const QStringList& args)
+{
+    bool isOk;
+    int block = option(args, "--blk").toInt(&isOk);
+    QByteArray data = QByteArray::fromHex(option(args, "-d").toLatin1());
+    if(!isOk || block < 0 || block >= blocks.size() || data.size() != 16)
+    {
+        out << "[-] Can't write block, invalid parameter\n";
+        return;
+    }
+    blocks[block] = data;
+    if(block == 0)
+        uid = data.left(4);
+    out << "[+] Write ( ok )\n";
+}
+
+void MockClient::hfMfEmulatorRead(const QStringList& args)
+{
+    bool isOk;
+    int block = option(args, "--blk").toInt(&isOk);
+    if(!isOk || block < 0 || block >= emulator.size())
+    {
+        out << "[-] block number is invalid\n";
+        return;
+    }
+    out << blockLine(block, emulator[block], false);
+}
+
+void MockClient::hfMfEmulatorWrite(const QStringList& args)
+{
+    bool isOk;
+    int block = option(args, "--blk").toInt(&isOk);
+    QByteArray data = QByteArray::fromHex(option(args, "-d").toLatin1());
+    if(!isOk || block < 0 || block >= emulator.size() || data.size() != 16)
+    {
+        out << "[-] Can't write block, invalid parameter\n";
+        return;
+    }
+    emulator[block] = data;
+}
+
+void MockClient::hfMfEmulatorClear(const QStringList& args)
+{
+    Q_UNUSED(args)
+    emulator.fill(QByteArray(16, '\0'));
+}
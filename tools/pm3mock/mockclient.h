@@ -0,0 +1,103 @@
+﻿#ifndef MOCKCLIENT_H
+#define MOCKCLIENT_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+// Reads stdin in its own thread, so a running command can notice Enter like the real client does
+class InputReader : public QThread
+{
+public:
+    bool readLine(QString* line); // blocks, returns false at the end of the input
+    bool waitForLine(int msec); // returns true if a line arrives in msec, then drops all the pending input
+
+protected:
+    void run() override;
+
+private:
+    QMutex mutex;
+    QWaitCondition lineAdded;
+    QStringList lines;
+    bool isEnd = false;
+};
+
+// A stand-in for the RRG/Iceman proxmark3 client, for running the GUI without hardware.
+// It reads commands from stdin, echoes the non-empty ones after the prompt like the real client does with a pipe,
+// and answers from a simulated MIFARE Classic card.
+class MockClient
+{
+public:
+    MockClient();
+
+    bool parseArgs(const QStringList& args);
+    int run();
+
+private:
+    typedef void (MockClient::*Handler)(const QStringList& args);
+
+    QTextStream out;
+    InputReader* input;
+    QString port;
+    QString prompt;
+    int defaultLatency; // ms, before every response
+    QList<QPair<QString, int>> latencies; // per command prefix, the longest matched prefix wins
+    QList<QPair<QString, Handler>> handlers;
+    QList<Handler> abortableHandlers; // their latency ends on Enter, like chk and nested of the real client
+    QStringList dictionary; // keys found by "hf mf chk"
+
+    QVector<QByteArray> blocks; // the card
+    QVector<QByteArray> emulator; // the emulator memory
+    QByteArray uid;
+    int divisor;
+    int bitsPerSample;
+    int decimation;
+    bool averaging;
+    int triggerThreshold;
+    int samplesToSkip;
+
+    void resetCard(int blockCount);
+    bool loadImage(const QString& filename);
+    int latencyOf(const QString& cmd) const;
+    void execute(const QString& line);
+
+    int sectorCount() const;
+    int sectorOf(int block) const;
+    int firstBlockOf(int sector) const;
+    int blockCountOf(int sector) const;
+    bool isTrailer(int block) const;
+    bool auth(int block, const QStringList& args);
+    QString blockLine(int block, const QByteArray& data, bool hideKeys) const;
+    void printKeyTable(bool allKeys);
+
+    static QString option(const QStringList& args, const QString& name);
+    static QString toHex(const QByteArray& data, const QString& separator = "");
+
+    void remark(const QStringList& args);
+    void hwVersion(const QStringList& args);
+    void hwStatus(const QStringList& args);
+    void hwSetLFDivisor(const QStringList& args);
+    void lfConfig(const QStringList& args);
+    void hf14aInfo(const QStringList& args);
+    void hfMfReadBlock(const QStringList& args);
+    void hfMfReadSector(const QStringList& args);
+    void hfMfWriteBlock(const QStringList& args);
+    void hfMfCheck(const QStringList& args);
+    void hfMfNested(const QStringList& args);
+    void hfMfDump(const QStringList& args);
+    void hfMfRestore(const QStringList& args);
+    void hfMfMagicRead(const QStringList& args);
+    void hfMfMagicWrite(const QStringList& args);
+    void hfMfEmulatorRead(const QStringList& args);
+    void hfMfEmulatorWrite(const QStringList& args);
+    void hfMfEmulatorClear(const QStringList& args);
+};
+
+#endif // MOCKCLIENT_H
@@ -0,0 +1,16 @@
+QT       -= gui
+QT       += core
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = pm3mock
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+    main.cpp \
+    mockclient.cpp \
+
+HEADERS += \
+    mockclient.h \